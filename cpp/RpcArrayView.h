@@ -0,0 +1,175 @@
+#ifndef _RPCARRAYVIEW_H_
+#define _RPCARRAYVIEW_H_
+
+#include "RpcTypeInfo.h"
+
+#include <string.h>
+
+namespace rpc {
+
+/**
+ * Read-only view of an array of constant-size elements, used for zero-copy deserialization.
+ *
+ * Specifying it as an argument of a remotely callable method gives the method direct access
+ * to the elements in the received message, without copying them into a container. It is
+ * compatible with any other collection of the same element type on the wire (so for example
+ * ArrayView<uint32_t> can be used in place of a std::vector<uint32_t>).
+ *
+ * The elements are in their serialized (little-endian) form, that is identical to their in-memory
+ * representation, but they are not necessarily aligned properly. Thus they can be accessed by
+ * value or copied out, and the raw bytes are available for bulk processing.
+ *
+ * NOTE: the view points into the buffer of the message being processed, so it is valid only
+ *       during the invocation of the method. The string of characters equivalent of this is
+ *       std::string_view (see RpcStlArray.h).
+ */
+template<class T>
+class ArrayView
+{
+    static_assert(detail::is_bulk_copyable<T>::value, "ArrayView requires elements with identical in-memory and serialized forms");
+
+    const char* ptr = nullptr;
+    uint32_t length = 0;
+
+public:
+    inline ArrayView() = default;
+
+    /**
+     * Create a view of _length_ elements stored in serialized form at _ptr_.
+     */
+    inline ArrayView(const char* ptr, uint32_t length): ptr(ptr), length(length) {}
+
+    /**
+     * Create a view of an array of elements in memory (e.g. for sending them without a copy).
+     */
+    static inline ArrayView of(const T* data, uint32_t length) {
+        return ArrayView(reinterpret_cast<const char*>(data), length);
+    }
+
+    /**
+     * STL-like size getter.
+     */
+    inline auto size() const {
+        return length;
+    }
+
+    /**
+     * Get the raw bytes of the elements.
+     */
+    inline const char* data() const {
+        return ptr;
+    }
+
+    /**
+     * Get the value of an element.
+     */
+    inline T operator[](uint32_t idx) const
+    {
+        T ret;
+        memcpy(&ret, ptr + idx * sizeof(T), sizeof(T));
+        return ret;
+    }
+
+    /**
+     * Copy the values of the elements to an array of at least _size()_ elements.
+     */
+    inline void copyTo(T* out) const {
+        memcpy(out, ptr, length * sizeof(T));
+    }
+
+    /**
+     * STL (and range based for expression) compatible iterator, the elements are accessed by value.
+     */
+    class Cursor
+    {
+        const char* ptr;
+
+        friend ArrayView;
+        inline Cursor(const char* ptr): ptr(ptr) {}
+
+    public:
+        inline T operator*() const
+        {
+            T ret;
+            memcpy(&ret, ptr, sizeof(T));
+            return ret;
+        }
+
+        inline auto& operator++() { ptr += sizeof(T); return *this; }
+        inline bool operator!=(const Cursor& o) const { return ptr != o.ptr; }
+    };
+
+    inline auto begin() const { return Cursor(ptr); }
+    inline auto end() const { return Cursor(ptr + length * sizeof(T)); }
+};
+
+/**
+ * Common serialization rules for views of arrays of constant-size elements.
+ *
+ * The view type _V_ must be constructible from a pointer to the serialized elements and their
+ * number, and provide the _data_ and _size_ methods for the same. On the reading side the view
+ * is pointed to the data in the stream, so the accessor needs to support direct access (_peek_).
+ *
+ * NOTE: see CollectionTypeBase for generic rules of collection serialization.
+ */
+template<class V, class T> struct ContiguousViewTypeBase: CollectionTypeBase<T>
+{
+    template<class S> static inline bool write(S& s, const V& v)
+    {
+        const uint32_t count = v.size();
+
+        if(!VarUint4::write(s, count))
+            return false;
+
+        if constexpr(detail::has_bulk_access<S>::value)
+        {
+            return !count || s.write((const void*)v.data(), count * sizeof(T));
+        }
+        else
+        {
+            for(auto p = v.data(); p != v.data() + count * sizeof(T); p += sizeof(T))
+            {
+                T x;
+                memcpy(&x, p, sizeof(T));
+
+                if(!TypeInfo<T>::write(s, x))
+                    return false;
+            }
+
+            return true;
+        }
+    }
+
+    template<class S> static inline bool read(S& s, V& v)
+    {
+        static_assert(detail::has_peek<S>::value, "zero-copy views require an accessor with direct access to the data");
+
+        uint32_t count;
+        if(!detail::readCollectionLength(s, count))
+            return false;
+
+        const auto length = detail::constSizeRun<T>(count);
+        auto p = s.peek(length);
+
+        if(!p || !s.skip(length))
+            return false;
+
+        v = V(p, count);
+        return true;
+    }
+
+    static constexpr inline size_t size(const V& v) {
+        return v.size() * sizeof(T) + VarUint4::size((uint32_t)v.size());
+    }
+};
+
+/**
+ * Serialization rules for ArrayView.
+ *
+ * NOTE: see CollectionTypeBase for generic rules of collection serialization.
+ */
+template<class T> struct TypeInfo<ArrayView<T>>: ContiguousViewTypeBase<ArrayView<T>, T> {};
+
+}
+
+#endif /* _RPCARRAYVIEW_H_ */
@@ -66,11 +66,7 @@ template<class T> struct TypeInfo<ArrayWriter<T>>: StlCompatibleCollectionTypeBa
         if(!VarUint4::write(a, v.length))
             return false;
 
-        for(auto i = 0u; i < v.length; i++)
-            if(!TypeInfo<T>::write(a, v.data[i]))
-                return false;
-
-        return true;    
+        return detail::writeElements(a, v.data, v.length);
     }
 };
 
@@ -0,0 +1,223 @@
+#ifndef _RPCBUFFERPOOL_H_
+#define _RPCBUFFERPOOL_H_
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+
+namespace rpc {
+
+/**
+ * Process wide pool of message buffers, organized into power of two size classes.
+ *
+ * Each thread has a small cache of free buffers for every size class, that is used without
+ * any synchronization. When the cache of a thread runs out of buffers it takes a batch from
+ * the shared overflow lists, when it gets full it moves a batch there. Thus buffers released
+ * by a different thread than the one that acquired them (e.g. messages built on a worker thread
+ * and sent by an IO thread) are recycled as well.
+ *
+ * Buffers larger than the largest size class are allocated and freed directly.
+ *
+ * The number of acquisitions served from the pool (hits) and the ones that needed a new
+ * allocation (misses) is counted, in steady state operation there should be no misses.
+ *
+ * The pool can be used from the destructors of static and thread_local objects as well (like an
+ * endpoint owned by one): the shared state is never destroyed, and after the cache of a thread has
+ * been handed over on thread exit the buffers of that thread go to the shared lists directly.
+ */
+class BufferPool
+{
+    static constexpr size_t minClassLog = 6, maxClassLog = 16;
+    static constexpr size_t classCount = maxClassLog - minClassLog + 1;
+    static constexpr unsigned int localCapacity = 32, batchSize = localCapacity / 2;
+
+    struct Shared
+    {
+        std::mutex lock;
+        std::vector<char*> free[classCount];
+        std::atomic<uint64_t> hits{0}, misses{0};
+    };
+
+    /**
+     * Cache of a thread, it is trivially destructible so it stays usable until the thread is gone.
+     */
+    struct Local
+    {
+        char* free[classCount][localCapacity];
+        unsigned int count[classCount] = {};
+        bool retired = false;
+    };
+
+    /**
+     * Hands over the cached buffers to the shared pool on thread exit.
+     */
+    struct Retirer
+    {
+        Local &l;
+
+        inline ~Retirer()
+        {
+            auto &s = shared();
+            std::lock_guard _(s.lock);
+
+            for(auto c = 0u; c < classCount; c++)
+            {
+                s.free[c].insert(s.free[c].end(), l.free[c], l.free[c] + l.count[c]);
+                l.count[c] = 0;
+            }
+
+            l.retired = true;
+        }
+    };
+
+    static inline Shared& shared()
+    {
+        // Intentionally never destroyed (see above).
+        static Shared& s = *new Shared;
+        return s;
+    }
+
+    static inline Local& local()
+    {
+        static thread_local Local l;
+        static thread_local Retirer r{l};
+        return l;
+    }
+
+    static inline constexpr size_t sizeClass(size_t size) {
+        return (size <= (size_t(1) << minClassLog)) ? 0 : (64 - __builtin_clzll(size - 1) - minClassLog);
+    }
+
+public:
+    struct Stats
+    {
+        uint64_t hits, misses;
+    };
+
+    /**
+     * Deleter for buffers acquired from the pool, remembers the capacity of the buffer.
+     */
+    struct Releaser
+    {
+        size_t capacity = 0;
+
+        inline void operator()(char* p) const {
+            release(p, capacity);
+        }
+    };
+
+    using Buffer = std::unique_ptr<char[], Releaser>;
+
+    /**
+     * Get a buffer of at least the requested size.
+     */
+    static inline Buffer allocate(size_t size)
+    {
+        size_t capacity;
+        auto p = acquire(size, capacity);
+        return Buffer(p, Releaser{capacity});
+    }
+
+    /**
+     * Get a buffer of at least the requested size, its actual size is stored in _capacity_.
+     *
+     * The buffer must be returned using _release_ with the same capacity.
+     */
+    static inline char* acquire(size_t size, size_t &capacity)
+    {
+        const auto c = sizeClass(size);
+        auto &s = shared();
+
+        if(classCount <= c)
+        {
+            s.misses.fetch_add(1, std::memory_order_relaxed);
+            capacity = size;
+            return new char[size];
+        }
+
+        capacity = size_t(1) << (c + minClassLog);
+        auto &l = local();
+
+        if(l.retired)
+        {
+            std::lock_guard _(s.lock);
+            auto &f = s.free[c];
+
+            if(!f.empty())
+            {
+                s.hits.fetch_add(1, std::memory_order_relaxed);
+                auto p = f.back();
+                f.pop_back();
+                return p;
+            }
+        }
+        else if(!l.count[c])
+        {
+            std::lock_guard _(s.lock);
+            auto &f = s.free[c];
+
+            for(; l.count[c] < batchSize && !f.empty(); f.pop_back())
+                l.free[c][l.count[c]++] = f.back();
+        }
+
+        if(l.count[c])
+        {
+            s.hits.fetch_add(1, std::memory_order_relaxed);
+            return l.free[c][--l.count[c]];
+        }
+
+        s.misses.fetch_add(1, std::memory_order_relaxed);
+        return new char[capacity];
+    }
+
+    /**
+     * Return a buffer to the pool.
+     */
+    static inline void release(char* p, size_t capacity)
+    {
+        const auto c = sizeClass(capacity);
+
+        if(classCount <= c)
+        {
+            delete[] p;
+            return;
+        }
+
+        auto &l = local();
+
+        if(l.retired)
+        {
+            auto &s = shared();
+            std::lock_guard _(s.lock);
+            s.free[c].push_back(p);
+            return;
+        }
+
+        if(l.count[c] == localCapacity)
+        {
+            auto &s = shared();
+            std::lock_guard _(s.lock);
+            l.count[c] -= batchSize;
+            s.free[c].insert(s.free[c].end(), l.free[c] + l.count[c], l.free[c] + localCapacity);
+        }
+
+        l.free[c][l.count[c]++] = p;
+    }
+
+    /**
+     * Get the hit and miss counters accumulated since the start of the process.
+     */
+    static inline Stats stats()
+    {
+        auto &s = shared();
+        return {s.hits.load(std::memory_order_relaxed), s.misses.load(std::memory_order_relaxed)};
+    }
+};
+
+}
+
+#endif /* _RPCBUFFERPOOL_H_ */
@@ -115,10 +115,9 @@ protected:
     template<class Call, class Callback, class... Args>
     inline void callWithCallback(Call& call, Callback&& cb, Args&&... args)
     {
-    	auto id = this->install([cb{std::move(cb)}](Endpoint& rpc, rpc::MethodHandle h, rpc::Arg<0, &Callback::operator()> arg)
+    	auto id = this->installOnce([cb{std::move(cb)}](Endpoint&, rpc::MethodHandle, rpc::Arg<0, &Callback::operator()> arg)
 		{
     		cb(rpc::move(arg));
-    		rpc.uninstall(h);
     	});
 
     	call.call(*this, std::forward<Args>(args)..., id);
@@ -130,10 +129,9 @@ protected:
     	std::promise<Ret> p;
     	auto f = p.get_future();
 
-    	auto id = this->install([p{std::move(p)}](Endpoint& rpc, rpc::MethodHandle h, Ret arg) mutable
+    	auto id = this->installOnce([p{std::move(p)}](Endpoint&, rpc::MethodHandle, Ret arg) mutable
 		{
     		p.set_value(arg);
-    		rpc.uninstall(h);
     	});
 
     	call.call(*this, std::forward<Args>(args)..., id);
@@ -143,11 +141,10 @@ protected:
     template<class Call, class Obj, class Callback, class... Args>
     inline void createWithCallback(Call& call, Obj obj, Callback&& cb, Args&&... args)
     {
-    	auto id = this->install([cb{std::move(cb)}, obj](Endpoint& rpc, rpc::MethodHandle h, rpc::Arg<0, &rpc::remove_cref_t<decltype(*obj)>::importRemote> import)
+    	auto id = this->installOnce([cb{std::move(cb)}, obj](Endpoint&, rpc::MethodHandle, rpc::Arg<0, &rpc::remove_cref_t<decltype(*obj)>::importRemote> import)
 		{
     		obj->importRemote(import);
     		cb();
-    		rpc.uninstall(h);
     	});
 
     	call.call(*this, std::forward<Args>(args)..., obj->exportLocal((Endpoint&)*this, obj), id);
@@ -156,11 +153,10 @@ protected:
     template<class Call, class Obj, class Callback, class... Args>
     inline void createWithCallbackRetval(Call& call, Obj obj, Callback&& cb, Args&&... args)
     {
-    	auto id = this->install([cb{std::move(cb)}, obj](Endpoint& rpc, rpc::MethodHandle h, rpc::Arg<0, &Callback::operator()> arg, rpc::Arg<0, &rpc::remove_cref_t<decltype(*obj)>::importRemote> import)
+    	auto id = this->installOnce([cb{std::move(cb)}, obj](Endpoint&, rpc::MethodHandle, rpc::Arg<0, &Callback::operator()> arg, rpc::Arg<0, &rpc::remove_cref_t<decltype(*obj)>::importRemote> import)
 		{
     		obj->importRemote(import);
     		cb(rpc::move(arg));
-    		rpc.uninstall(h);
     	});
 
     	call.call(*this, std::forward<Args>(args)..., obj->exportLocal((Endpoint&)*this, obj), id);
@@ -172,11 +168,10 @@ protected:
     	std::promise<void> p;
     	auto f = p.get_future();
 
-    	auto id = this->install([p{std::move(p)}, obj](Endpoint& rpc, rpc::MethodHandle h, rpc::Arg<0, &rpc::remove_cref_t<decltype(*obj)>::importRemote> import) mutable
+    	auto id = this->installOnce([p{std::move(p)}, obj](Endpoint&, rpc::MethodHandle, rpc::Arg<0, &rpc::remove_cref_t<decltype(*obj)>::importRemote> import) mutable
 		{
     		obj->importRemote(import);
     		p.set_value();
-    		rpc.uninstall(h);
     	});
 
     	call.call(*this, std::forward<Args>(args)..., obj->exportLocal((Endpoint&)*this, obj), id);
@@ -189,11 +184,10 @@ protected:
     	std::promise<Ret> p;
 		auto f = p.get_future();
 
-    	auto id = this->install([p{std::move(p)}, obj](Endpoint& rpc, rpc::MethodHandle h, Ret arg, rpc::Arg<0, &rpc::remove_cref_t<decltype(*obj)>::importRemote> import) mutable
+    	auto id = this->installOnce([p{std::move(p)}, obj](Endpoint&, rpc::MethodHandle, Ret arg, rpc::Arg<0, &rpc::remove_cref_t<decltype(*obj)>::importRemote> import) mutable
 		{
     		obj->importRemote(import);
     		p.set_value(rpc::move(arg));
-    		rpc.uninstall(h);
     	});
 
     	call.call(*this, std::forward<Args>(args)..., obj->exportLocal((Endpoint&)*this, obj), id);
@@ -205,6 +199,7 @@ public:
 
     using Endpoint::call;
     using Endpoint::install;
+    using Endpoint::installOnce;
     using Endpoint::uninstall;
     using Endpoint::lookup;
     using Endpoint::provide;
@@ -11,6 +11,13 @@ namespace rpc {
  *
  * Specifying it as an argument to a remote method invocation enables
  * the serialization of homogeneous synthetic data as a collection.
+ *
+ * The generator is invoked exactly once for each element if the message
+ * can be built in a single pass (see Core::buildCallSinglePass), which is
+ * selected automatically for elements that are not constant-size. Otherwise
+ * (i.e. with a message factory that needs the length in advance) a copy of
+ * the functor is evaluated once more to determine the size of the elements,
+ * so it must produce the same sequence each time.
  */
 template<class T, class C>
 class CollectionGenerator
@@ -109,6 +116,17 @@ static auto generateCollection(uint32_t length, C &&c)
  */
 template<class T, class C> struct TypeInfo<CollectionGenerator<T, C>>: StlCompatibleCollectionTypeBase<CollectionGenerator<T, C>, T>
 {
+    /**
+     * Determine the size without invoking the generator if the elements are constant-size.
+     */
+    static inline size_t size(const CollectionGenerator<T, C> &v)
+    {
+        if constexpr(TypeInfo<T>::isConstSize())
+            return detail::constSizeRun<T>(v.size()) + VarUint4::size(v.size());
+        else
+            return TypeInfo::StlCompatibleCollectionTypeBase::size(v);
+    }
+
     template<class A> static inline bool write(A& a, const CollectionGenerator<T, C> &v)
     {
     	auto length = v.size();
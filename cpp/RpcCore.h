@@ -5,6 +5,45 @@
 
 namespace rpc {
 
+namespace detail
+{
+	/**
+	 * Checks if a message factory can build messages without knowing their length in advance.
+	 */
+	template<class F, class = void> struct has_growing_build: false_type {};
+	template<class F> struct has_growing_build<F, decltype(void(declval<F>().buildGrowing()))>: true_type {};
+
+	/**
+	 * Checks if a registry can allocate the keys for new entries itself.
+	 */
+	template<class R, class V, class = void> struct has_insert: false_type {};
+	template<class R, class V> struct has_insert<R, V, decltype(void(declval<R>().insert(rpc::move(declval<V>()))))>: true_type {};
+
+	/**
+	 * Checks if a registry can store one-shot entries separately (that are removed when invoked).
+	 */
+	template<class R, class V, class = void> struct has_insert_once: false_type {};
+	template<class R, class V> struct has_insert_once<R, V, decltype(void(declval<R>().insertOnce(rpc::move(declval<V>()))))>: true_type {};
+
+	/**
+	 * Checks if a registry can be told to leave a range of keys unallocated.
+	 */
+	template<class R, class K, class = void> struct has_reserve_keys: false_type {};
+	template<class R, class K> struct has_reserve_keys<R, K, decltype(void(declval<R>().reserveKeys(declval<K>())))>: true_type {};
+
+	/**
+	 * Checks if the values found in a registry must be used in a read section (that delays their destruction).
+	 */
+	template<class R, class = void> struct has_read_section: false_type {};
+	template<class R> struct has_read_section<R, decltype(void(declval<R>().leave(declval<R>().enter())))>: true_type {};
+}
+
+/**
+ * Tag for requesting single-pass serialization of a call (see Core::buildCallSinglePass).
+ */
+struct SinglePass {};
+static constexpr SinglePass singlePass{};
+
 /**
  * RPC Call dispatcher.
  * 
@@ -60,6 +99,11 @@ private:
 		 */
 		Invoker(T&& target): target(rpc::move(target)) {}
 
+		/**
+		 * Allows the Pointer policy to store the invoker inline and move it along with itself.
+		 */
+		Invoker(Invoker&&) = default;
+
 		/**
 		 * The virtual destructor is required because the captured 
 		 * functor may have non-trivial destructor. (for example 
@@ -78,6 +122,31 @@ private:
 		}
 	};
 
+	/**
+	 * Invoker of a one-shot method, that removes itself after the invocation if it is stored 
+	 * as a regular registry entry (i.e. if the _core_ is set).
+	 */
+	template<class T, class... NominalArgs>
+	struct OnceInvoker: Invoker<T, NominalArgs...>
+	{
+		Core* core = nullptr;
+
+		OnceInvoker(T&& target): Invoker<T, NominalArgs...>(rpc::move(target)) {}
+		OnceInvoker(OnceInvoker&&) = default;
+
+		virtual const char* invoke(InputAccessor &a, CallId id, ExtraArgs... extraArgs) override
+		{
+			auto c = core;
+			auto ret = Invoker<T, NominalArgs...>::invoke(a, id, extraArgs...);
+
+			// This destroys the invoker, so no members can be accessed after it.
+			if(c)
+				c->removeCall(id);
+
+			return ret;
+		}
+	};
+
 	/**
 	 * Numeric identifier based RPC method registry.
 	 */
@@ -88,6 +157,71 @@ private:
 	 */
 	CallId maxId = 0;
 
+	/**
+	 * Register an invoker for any available method identifier.
+	 */
+	inline CallId addInvoker(Pointer<IInvoker>&& ptr)
+	{
+		if constexpr(detail::has_insert<decltype(registry), Pointer<IInvoker>>::value)
+		{
+			return registry.insert(rpc::move(ptr));
+		}
+		else
+		{
+			CallId id;
+
+			do 
+			{
+				id = maxId++;
+			}
+			while(!registry.add(id, rpc::move(ptr)));
+			
+			return id;
+		}
+	}
+
+	/**
+	 * Build a message either in two passes (determining the size then serializing 
+	 * into a buffer of that size) or in a single one (serializing into a growing 
+	 * buffer and filling in the length afterwards) if the factory supports it.
+	 */
+	template<bool singlePass, class... NominalArgs, class... ActualArgs, class Factory>
+	static inline auto build(Factory& factory, bool &ok, CallId id, ActualArgs&&... args)
+	{
+		using C = Call<NominalArgs...>;
+		C c{id};
+
+		static_assert(writeSignature<NominalArgs...>(""_ctstr) == writeSignature<ActualArgs...>(""_ctstr), "RPC invocation signature mismatched");
+
+		if constexpr(singlePass && detail::has_growing_build<Factory>::value)
+		{
+			auto pdu = factory.buildGrowing();
+			ok = serialize(pdu, c, rpc::forward<ActualArgs>(args)...);
+			return factory.done(rpc::move(pdu));
+		}
+		else
+		{
+			auto size = determineSize(c, args...);
+			auto pdu = factory.build(size);
+
+			ok = serialize(pdu, c, rpc::forward<ActualArgs>(args)...);
+			return factory.done(rpc::move(pdu));
+		}
+	}
+
+	/**
+	 * Look up and call the invoker for a regular (not one-shot) identifier.
+	 */
+	inline const char* invokeRegistered(InputAccessor &a, CallId id, ExtraArgs... args)
+	{
+		bool ok;
+		auto it = registry.find(id, ok);
+		if(!ok)
+			return Errors::wrongMethodRequest;
+
+		return (*it)->invoke(a, id, args...);
+	}
+
 public:
 	/**
 	 * Process an incoming message. 
@@ -108,12 +242,56 @@ public:
 		if(!VarUint4::read(a, id))
 			return Errors::messageFormatError;
 
-		bool ok;
-		auto it = registry.find(id, ok);
-		if(!ok)
-			return Errors::wrongMethodRequest;
+		return dispatch(a, id, args...);
+	}
 
-		return (*it)->invoke(a, id, args...);
+	/**
+	 * Invoke the registered method for an identifier already parsed from the message.
+	 * 
+	 * This is the second half of _execute_, for front-ends that dispatch some of the 
+	 * identifiers themselves before consulting the registry (see StaticMethods).
+	 */
+	const char* dispatch(InputAccessor &a, CallId id, ExtraArgs... args)
+	{
+		if constexpr(detail::has_insert_once<decltype(registry), Pointer<IInvoker>>::value)
+		{
+			if(registry.isOnce(id))
+			{
+				if(auto it = registry.claimOnce(id))
+				{
+					auto ret = (*it)->invoke(a, id, args...);
+					registry.releaseOnce(id);
+					return ret;
+				}
+			}
+		}
+
+		if constexpr(detail::has_read_section<decltype(registry)>::value)
+		{
+			const auto s = registry.enter();
+			auto ret = invokeRegistered(a, id, args...);
+			registry.leave(s);
+			return ret;
+		}
+		else
+		{
+			return invokeRegistered(a, id, args...);
+		}
+	}
+
+	/**
+	 * Exclude the identifiers below _count_ from being assigned to methods registered by _add_.
+	 * 
+	 * It is used to keep a range of well-known identifiers free (see StaticMethods), so it
+	 * must be called before registering any methods.
+	 */
+	inline void reserve(CallId count)
+	{
+		if constexpr(detail::has_reserve_keys<decltype(registry), CallId>::value)
+			registry.reserveKeys(count);
+
+		if(maxId < count)
+			maxId = count;
 	}
 
 	/**
@@ -131,22 +309,42 @@ public:
 	/**
 	 * Register a method for any available method identifier.
 	 * 
+	 * If the registry can allocate the identifiers itself (see SlotTableRegistry) it is done
+	 * by the registry, otherwise the identifiers are assigned sequentially.
+	 * 
 	 * Returns the associated method identifier.
 	 */
 	template<class... Args, class T>
-	inline CallId add(T&& call) 
-	{
-		auto ptr = Pointer<IInvoker>::template make<Invoker<T, Args...>>(rpc::move(call));
+	inline CallId add(T&& call) {
+		return addInvoker(Pointer<IInvoker>::template make<Invoker<T, Args...>>(rpc::move(call)));
+	}
 
-		CallId id;
+	/**
+	 * Register a method that can be invoked only once (like a reply callback).
+	 * 
+	 * The registration is removed automatically when the method is invoked, so the method
+	 * must not remove it itself. It can be removed beforehand though (e.g. to cancel the
+	 * request if sending it failed). If the registry supports it, one-shot methods are kept 
+	 * separately from the regular ones (see SlotTableRegistry), otherwise they are stored 
+	 * as regular entries that remove themselves after the invocation.
+	 * 
+	 * Returns the associated method identifier.
+	 */
+	template<class... Args, class T>
+	inline CallId addOnce(T&& call) 
+	{
+		auto ptr = Pointer<IInvoker>::template make<OnceInvoker<T, Args...>>(rpc::move(call));
 
-		do 
+		if constexpr(detail::has_insert_once<decltype(registry), Pointer<IInvoker>>::value)
 		{
-			id = maxId++;
+			auto id = registry.insertOnce(rpc::move(ptr));
+
+			if(id != CallId(-1))
+				return id;
 		}
-		while(!registry.add(id, rpc::move(ptr)));
-		
-		return id;
+
+		static_cast<OnceInvoker<T, Args...>&>(*ptr).core = this;
+		return addInvoker(rpc::move(ptr));
 	}
 
 	/**
@@ -163,20 +361,28 @@ public:
 	 * Build a message for invoking a method with the provided identifier
 	 * and arguments. Arguments are serialized using the serialize helper
 	 * according to the rules specified by the TypeInfo template class.
+	 * 
+	 * Single-pass serialization is used if determining the size of any of
+	 * the arguments would require traversing it (see buildCallSinglePass).
 	 */
 	template<class... NominalArgs, class... ActualArgs, class Factory>
 	static inline auto buildCall(Factory& factory, bool &ok, CallId id, ActualArgs&&... args)
 	{
-		using C = Call<NominalArgs...>;
-		C c{id};
-
-		static_assert(writeSignature<NominalArgs...>(""_ctstr) == writeSignature<ActualArgs...>(""_ctstr), "RPC invocation signature mismatched");
-
-		auto size = determineSize(c, args...);
-		auto pdu = factory.build(size);
+		constexpr bool costlySize = (detail::has_costly_size<remove_cref_t<ActualArgs>>::value || ... || false);
+		return build<costlySize, NominalArgs...>(factory, ok, id, rpc::forward<ActualArgs>(args)...);
+	}
 
-		ok = serialize(pdu, c, rpc::forward<ActualArgs>(args)...);
-		return factory.done(rpc::move(pdu));
+	/**
+	 * Build a message for invoking a method traversing the arguments only once.
+	 * 
+	 * The arguments are serialized into a buffer that is grown as needed and
+	 * the length header is filled in at the end. If the message factory does 
+	 * not support this (e.g. because it reserves space in a ring buffer for 
+	 * the exact length), the size is determined in advance as usual.
+	 */
+	template<class... NominalArgs, class... ActualArgs, class Factory>
+	static inline auto buildCallSinglePass(Factory& factory, bool &ok, CallId id, ActualArgs&&... args) {
+		return build<true, NominalArgs...>(factory, ok, id, rpc::forward<ActualArgs>(args)...);
 	}
 };
 
@@ -7,6 +7,7 @@
 #include "RpcSymbol.h"
 #include "RpcArrayWriter.h"
 #include "RpcStreamReader.h"
+#include "RpcStaticDispatch.h"
 #include "RpcSignatureGenerator.h"
 
 namespace rpc {
@@ -21,6 +22,11 @@ namespace detail
 		static inline decltype(auto) install(Core &core, C&& c) {
 			return Call<remove_cref_t<Args>...>{core.template add<remove_cref_t<Args>...>(rpc::forward<C>(c))};
 		}
+
+		template<class Core, class C>
+		static inline decltype(auto) installOnce(Core &core, C&& c) {
+			return Call<remove_cref_t<Args>...>{core.template addOnce<remove_cref_t<Args>...>(rpc::forward<C>(c))};
+		}
 	};
 
 	template<class Ret, class Type, class Ctx1, class Ctx2, class... Args> struct CallOperatorSignatureUtility<Ret (Type::*)(Ctx1, Ctx2, Args...)>:
@@ -47,6 +53,7 @@ class Endpoint:
 	using CallId = typename Endpoint::Core::CallId;
 
 	Registry<decltype(""_ctstr.hash()), CallId> symbolRegistry;
+	uint32_t maxCollectionSize = -1u;
 
 	const char* doLookup(uint64_t id, size_t length, CallId cb)
 	{
@@ -74,40 +81,96 @@ class Endpoint:
 		return Errors::couldNotCreateLookupMessage;
 	}
 
+	/**
+	 * Build a call message using the supplied callback and send it.
+	 */
+	template<class Builder>
+	inline const char* buildAndSend(Builder&& builder)
+	{
+		bool buildOk;
+
+		auto f = static_cast<IoEngine*>(this)->messageFactory();
+
+		auto data = builder(f, buildOk);
+		if(buildOk)
+		{
+			if(static_cast<IoEngine*>(this)->send(rpc::move(data)))
+				return nullptr;
+
+			return Errors::couldNotSendMessage;
+		}
+		else
+		{
+			return Errors::couldNotCreateMessage;
+		}
+	}
+
+	/**
+	 * Find the identifier of a public method, the static ones are checked first (if there are any).
+	 */
+	inline bool findSymbol(uint64_t idHash, CallId &id)
+	{
+		if constexpr(detail::has_static_methods<IoEngine>::value)
+		{
+			if(IoEngine::StaticMethods::find(idHash, id))
+				return true;
+		}
+
+		bool ok;
+		auto result = symbolRegistry.find(idHash, ok);
+		if(ok)
+			id = *result;
+
+		return ok;
+	}
+
+	/**
+	 * The built-in lookup method (registered at _lookupId_).
+	 */
+	static const char* lookupMethod(Endpoint& ep, const MethodHandle&, uint64_t idHash, Call<CallId> callback)
+	{
+		CallId r = invalidId;
+		const char* ret = nullptr;
+
+		if(!ep.findSymbol(idHash, r))
+		{
+			ret = Errors::unknownMethodRequested;
+		}
+
+		if(auto err = ep.call(callback, r))
+		{
+			ret = err;
+		}
+
+		return ret;
+	}
+
 public:
 	static constexpr CallId lookupId = 0, invalidId = -1u;
 
 	/**
 	 * Initialize the internal state of the RPC endpoint.
 	 * 
+	 * If the IoEngine declares a table of StaticMethods, the identifiers used by it are
+	 * reserved and the lookup method is dispatched statically as well, so nothing needs
+	 * to be registered.
+	 * 
 	 * NOTE: Must be called before any other member.
 	 */
 	bool init()
 	{
-		return this->Endpoint::Core::template addCallAt<uint64_t, Call<CallId>>(lookupId,
-		[](Endpoint& ep, const MethodHandle &id, uint64_t idHash, Call<CallId> callback)
+		if constexpr(detail::has_static_methods<IoEngine>::value)
 		{
-			CallId r = invalidId;
-			const char* ret = nullptr;
+			using Static = typename IoEngine::StaticMethods;
+			static_assert(!Static::contains(lookupId), "the identifier of the lookup method can not be used by a static method");
 
-			bool ok;
-			auto result = ep.symbolRegistry.find(idHash, ok);
-			if(ok)
-			{
-				r = *result;
-			}
-			else
-			{
-				ret = Errors::unknownMethodRequested;
-			}
-
-			if(auto err = ep.call(callback, r))
-			{
-				ret = err;
-			}
-
-			return ret;
-		});
+			this->Endpoint::Core::reserve(Static::idLimit);
+			return true;
+		}
+		else
+		{
+			return this->Endpoint::Core::template addCallAt<uint64_t, Call<CallId>>(lookupId, &lookupMethod);
+		}
 	}
 
 	/**
@@ -122,8 +185,62 @@ public:
 	 *  - IO error during reading or
 	 *  - Failure to find the requested method in the registry.
 	 */
-	auto process(InputAccessor& a) {
-		return Endpoint::Core::execute(a, *this);
+	auto process(InputAccessor& a)
+	{
+		if constexpr(detail::has_collection_limit<InputAccessor>::value)
+			a.setCollectionLimit(maxCollectionSize);
+
+		if constexpr(detail::has_static_methods<IoEngine>::value)
+		{
+			CallId id;
+
+			if(!VarUint4::read(a, id))
+				return Errors::messageFormatError;
+
+			if(id == lookupId)
+				return detail::StaticHandlerSignature<decltype(&lookupMethod)>::invoke(a, &lookupMethod, *this, id);
+
+			const char* ret;
+			if(IoEngine::StaticMethods::dispatch(id, a, *static_cast<IoEngine*>(this), ret))
+				return ret;
+
+			return Endpoint::Core::dispatch(a, id, *this);
+		}
+		else
+		{
+			return Endpoint::Core::execute(a, *this);
+		}
+	}
+
+	/**
+	 * Set the maximal number of elements of a collection in an incoming message.
+	 * 
+	 * Messages containing longer collections are rejected (as malformed) before allocating 
+	 * memory for the elements. Requires an input accessor that supports limiting the length
+	 * of collections (like the CheckedAccessor of PreallocatedMemoryBufferStream).
+	 */
+	inline void setMaxCollectionSize(uint32_t n) {
+		maxCollectionSize = n;
+	}
+
+	/**
+	 * Process an incoming message, deserializing the arguments into a per-message arena.
+	 * 
+	 * The containers among the arguments (and the ones nested in them) that can use the
+	 * memory resource of the arena (like std::pmr::vector or std::pmr::map) allocate all
+	 * their storage from it, which is then released in one step after the method returned.
+	 * 
+	 * NOTE: the arguments must not outlive the invocation of the method, so they can not be
+	 * moved into longer lived objects - they need to be copied.
+	 */
+	template<class Arena>
+	auto process(InputAccessor& a, Arena& arena)
+	{
+		a.setMemoryResource(arena.resource());
+		auto ret = process(a);
+		a.setMemoryResource(nullptr);
+		arena.reset();
+		return ret;
 	}
 
 	/**
@@ -152,6 +269,22 @@ public:
 		return detail::CallOperatorSignatureUtility<decltype(&C::operator())>::install(core, rpc::move(c));
 	}
 
+	/**
+	 * Register a method that can be invoked only once, like a reply callback.
+	 * 
+	 * The arguments are the same as for _install_, but the registration is removed 
+	 * automatically when the method is invoked (so it must not uninstall itself). It 
+	 * can be uninstalled before that, for example if sending the request failed.
+	 * 
+	 * Returns a Call method handle that can be used to execute the registered method.
+	 */
+	template<class C>
+	inline auto installOnce(C&& c) 
+	{
+		auto &core = *((typename Endpoint::Core*)this);
+		return detail::CallOperatorSignatureUtility<decltype(&C::operator())>::installOnce(core, rpc::move(c));
+	}
+
 	/**
 	 * Removes a method registration identified by an opaque handle supplied to the 
 	 * method at its invocation by the RPC engine.
@@ -194,22 +327,24 @@ public:
 	template<class... NominalArgs, class... ActualArgs>
 	inline const char* call(const Call<NominalArgs...> &call, ActualArgs&&... args)
 	{
-		bool buildOk;
-
-		auto f = static_cast<IoEngine*>(this)->messageFactory();
-
-		auto data = this->Endpoint::Core::template buildCall<NominalArgs...>(f, buildOk, call.id, rpc::forward<ActualArgs>(args)...);
-		if(buildOk)
-		{
-			if(static_cast<IoEngine*>(this)->send(rpc::move(data)))
-				return nullptr;
+		return buildAndSend([&](auto& f, bool &ok) {
+			return this->Endpoint::Core::template buildCall<NominalArgs...>(f, ok, call.id, rpc::forward<ActualArgs>(args)...);
+		});
+	}
 
-			return Errors::couldNotSendMessage;
-		}
-		else
-		{
-			return Errors::couldNotCreateMessage;
-		}
+	/**
+	 * Initiate a remote method call with the supplied parameters, using single-pass serialization.
+	 * 
+	 * To be used for arguments that are expensive to traverse even if they are not detected as 
+	 * such automatically (e.g. a user defined type with a complex size calculation), see 
+	 * Core::buildCallSinglePass for details.
+	 */
+	template<class... NominalArgs, class... ActualArgs>
+	inline const char* call(SinglePass, const Call<NominalArgs...> &call, ActualArgs&&... args)
+	{
+		return buildAndSend([&](auto& f, bool &ok) {
+			return this->Endpoint::Core::template buildCallSinglePass<NominalArgs...>(f, ok, call.id, rpc::forward<ActualArgs>(args)...);
+		});
 	}
 
 	/**
@@ -225,6 +360,13 @@ public:
 	template<size_t n, class... Args, class C>
 	inline const char* provide(const Symbol<n, Args...> &sym, C&& c)
 	{
+		if constexpr(detail::has_static_methods<IoEngine>::value)
+		{
+			CallId staticId;
+			if(IoEngine::StaticMethods::find(sym.hash(), staticId))
+				return Errors::symbolAlreadyExported;
+		}
+
 		Call<Args...> id = this->install(rpc::forward<C>(c));
 		
 		if(!symbolRegistry.add(sym.hash(), rpc::move(id.id)))
@@ -296,14 +438,8 @@ public:
 	inline const char* lookup(const Symbol<n, Args...> &sym, C&& c) 
 	{
 		auto &core = *((typename Endpoint::Core*)this);
-		auto id = core.template add<CallId>([this, c{rpc::forward<C>(c)}](Endpoint &ep, const rpc::MethodHandle &handle, CallId result) mutable
-		{
+		auto id = core.template addOnce<CallId>([this, c{rpc::forward<C>(c)}](Endpoint &ep, const rpc::MethodHandle &handle, CallId result) mutable {
 			c(ep, result != invalidId, Call<Args...>{result});
-
-			if(!ep.removeCall(handle.id))
-				return Errors::internalError; // GCOV_EXCL_LINE
-
-			return (const char*) nullptr;
 		});
 
 		if(auto err = doLookup(sym.hash(), n, id))
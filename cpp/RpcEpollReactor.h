@@ -0,0 +1,525 @@
+#ifndef _RPCEPOLLREACTOR_H_
+#define _RPCEPOLLREACTOR_H_
+
+#include "RpcFail.h"
+#include "RpcFdStreamAdapter.h"
+
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <unordered_map>
+
+#include <cassert>
+#include <cstring>
+#include <cerrno>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <limits.h>
+#include <sys/uio.h>
+#include <sys/epoll.h>
+
+namespace rpc {
+
+template<class> class EpollReactor;
+
+/**
+ * Message transport adapter for a non-blocking stream socket driven by an EpollReactor.
+ *
+ * It uses the same framing as the FdStreamAdapter, so the two are interoperable.
+ *
+ * The inbound data is read by the reactor into a buffer shared by all of its connections,
+ * complete frames are processed right from there. Only the incomplete frame at the end of
+ * the data read is copied into a per-connection buffer, so an idle connection needs very
+ * little memory.
+ *
+ * Outbound messages are written immediately if possible, the part that could not be written
+ * is queued and sent when the socket becomes writable again. While the reactor dispatches the
+ * messages obtained by a single read the writes are deferred, so that replies to them are sent
+ * using a single gather write. If the amount of queued data exceeds the _high water mark_
+ * no more data is read from the connection until the queue is drained to half of it. Sending
+ * fails if the queue would grow larger than the _queue limit_.
+ *
+ * NOTE: receiving is done by the thread running the reactor, but sending is allowed from any thread.
+ */
+class EpollConnection
+{
+    template<class> friend class EpollReactor;
+
+    static constexpr size_t maxIov = 64;
+
+    int epfd, fd;
+
+    std::deque<PreallocatedMemoryBufferStream> txQueue;
+    size_t txOffset = 0, txQueuedBytes = 0;
+    size_t txHighWater = 256 * 1024, txLimit = 16 * 1024 * 1024;
+    uint32_t events = 0;
+    bool rxPaused = false, deferred = false, broken = false;
+    std::mutex txLock;
+
+    std::vector<char> rxPartial;
+    size_t rxMaxFrame = size_t(-1);
+    bool closed = false;
+    const char* error = nullptr;
+
+    /**
+     * Register with the epoll instance.
+     */
+    inline bool attach()
+    {
+        epoll_event ev{};
+        ev.events = events = EPOLLIN | EPOLLRDHUP;
+        ev.data.ptr = this;
+        return epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev) == 0;
+    }
+
+    /**
+     * Adjust the set of events monitored according to the state of the outbound queue.
+     *
+     * NOTE: must be called with the transmit lock held.
+     */
+    inline bool updateEvents()
+    {
+        if(rxPaused ? (txQueuedBytes <= txHighWater / 2) : (txHighWater < txQueuedBytes))
+            rxPaused = !rxPaused;
+
+        const uint32_t wanted = uint32_t(EPOLLRDHUP) | (rxPaused ? 0u : uint32_t(EPOLLIN)) | (txQueue.empty() ? 0u : uint32_t(EPOLLOUT));
+
+        if(wanted != events)
+        {
+            epoll_event ev{};
+            ev.events = wanted;
+            ev.data.ptr = this;
+
+            if(epoll_ctl(epfd, EPOLL_CTL_MOD, fd, &ev) != 0)
+                return false;
+
+            events = wanted;
+        }
+
+        return true;
+    }
+
+    /**
+     * Write as much of the queued data as the socket accepts without blocking.
+     *
+     * Returns false on IO error.
+     *
+     * NOTE: must be called with the transmit lock held.
+     */
+    inline bool flushQueue()
+    {
+        while(!txQueue.empty())
+        {
+            iovec iov[maxIov];
+            size_t n = 0, total = 0;
+
+            for(auto it = txQueue.begin(); it != txQueue.end() && n < maxIov; ++it, ++n)
+            {
+                auto ptr = it->frame() + (n ? 0 : txOffset);
+                iov[n] = {ptr, (size_t)(it->end - ptr)};
+                total += iov[n].iov_len;
+            }
+
+            const auto written = writev(fd, iov, (int)n);
+
+            if(written < 0)
+            {
+                if(errno == EINTR)
+                    continue;
+
+                if(errno == EAGAIN || errno == EWOULDBLOCK)
+                    break;
+
+                return false;
+            }
+
+            txQueuedBytes -= written;
+
+            for(auto remaining = (size_t)written; remaining;)
+            {
+                auto &f = txQueue.front();
+                const auto length = (size_t)(f.end - f.frame()) - txOffset;
+
+                if(remaining < length)
+                {
+                    txOffset += remaining;
+                    break;
+                }
+
+                remaining -= length;
+                txOffset = 0;
+                txQueue.pop_front();
+            }
+
+            if((size_t)written < total)
+                break;
+        }
+
+        return true;
+    }
+
+    /**
+     * Flush the outbound queue and update the monitored events, marks the connection broken on failure.
+     */
+    inline bool flush()
+    {
+        std::lock_guard _(txLock);
+        deferred = false;
+
+        if(broken || !flushQueue() || !updateEvents())
+            return !(broken = true);
+
+        return true;
+    }
+
+    /**
+     * Process the data read from the socket, the callback is invoked with an accessor for each complete message.
+     *
+     * Returns false on malformed framing or if the callback returns false.
+     */
+    template<class C>
+    inline bool consume(char* p, size_t n, C&& cb)
+    {
+        size_t headerLength, frameLength;
+        bool ok = true;
+
+        while(n)
+        {
+            if(!rxPartial.empty())
+            {
+                if(!detail::decodeFrameHeader(rxPartial.data(), rxPartial.size(), headerLength, frameLength, ok, rxMaxFrame))
+                {
+                    if(!ok)
+                        return false;
+
+                    rxPartial.push_back(*p++);
+                    n--;
+                    continue;
+                }
+
+                const auto missing = frameLength - rxPartial.size();
+                const auto taken = (missing < n) ? missing : n;
+                rxPartial.insert(rxPartial.end(), p, p + taken);
+                p += taken;
+                n -= taken;
+
+                if(rxPartial.size() < frameLength)
+                    break;
+
+                auto frame = rpc::move(rxPartial);
+                rxPartial.clear();
+
+                if(!cb(InputAccessor(frame.data() + headerLength, frame.data() + frameLength)))
+                    return false;
+            }
+            else if(detail::decodeFrameHeader(p, n, headerLength, frameLength, ok, rxMaxFrame) && frameLength <= n)
+            {
+                auto frame = p;
+                p += frameLength;
+                n -= frameLength;
+
+                if(!cb(InputAccessor(frame + headerLength, frame + frameLength)))
+                    return false;
+            }
+            else if(!ok)
+            {
+                return false;
+            }
+            else
+            {
+                rxPartial.assign(p, p + n);
+                break;
+            }
+        }
+
+        return true;
+    }
+
+public:
+    using InputAccessor = PreallocatedMemoryBufferStream::CheckedAccessor;
+
+    EpollConnection(const EpollConnection&) = delete;
+    inline EpollConnection(int epfd, int fd): epfd(epfd), fd(fd) {}
+
+    /**
+     * Closes the socket.
+     */
+    inline ~EpollConnection() {
+        ::close(fd);
+    }
+
+    inline auto messageFactory() {
+        return PreallocatedMemoryBufferStreamWriterFactory{};
+    }
+
+    /**
+     * Send a message.
+     *
+     * The message is written immediately if nothing is queued before it and the reactor is not
+     * dispatching messages for this connection. Otherwise it is queued and sent later.
+     *
+     * Returns false if the connection is broken or the queue limit would be exceeded.
+     */
+    bool send(PreallocatedMemoryBufferStream&& data)
+    {
+        std::lock_guard _(txLock);
+
+        const auto length = (size_t)(data.end - data.frame());
+
+        if(broken || txLimit < txQueuedBytes + length)
+            return false;
+
+        txQueue.push_back(std::move(data));
+        txQueuedBytes += length;
+
+        if(deferred)
+            return true;
+
+        if(txQueue.size() == 1 && !flushQueue())
+            return !(broken = true);
+
+        if(!updateEvents())
+            return !(broken = true);
+
+        return true;
+    }
+
+    /**
+     * Set the amount of queued outbound data above which reading is suspended and the maximal
+     * amount of data that can be queued.
+     */
+    inline void setQueueLimits(size_t highWater, size_t limit)
+    {
+        std::lock_guard _(txLock);
+        assert(highWater <= limit);
+        txHighWater = highWater;
+        txLimit = limit;
+    }
+
+    /**
+     * Set the maximal length of an inbound frame (including the length header), the connection
+     * is closed if the peer announces a longer one.
+     */
+    inline void setMaxMessageSize(size_t length) {
+        rxMaxFrame = length;
+    }
+
+    /**
+     * Get the amount of outbound data waiting to be written.
+     */
+    inline size_t pendingBytes()
+    {
+        std::lock_guard _(txLock);
+        return txQueuedBytes;
+    }
+
+    /**
+     * Get the error returned by processing the last message that failed (one of the rpc::Errors
+     * constants or an error returned by a method), or nullptr if there was none.
+     *
+     * Only a malformed message (messageFormatError) makes the reactor close the connection, as the
+     * framing of the rest of the stream can not be trusted then. Other failures - like a message
+     * addressed to a method that was removed, or a reply arriving after its request was cancelled -
+     * are only recorded here.
+     */
+    inline const char* processingError() const {
+        return error;
+    }
+
+    /**
+     * Get the underlying socket.
+     */
+    inline int socket() const {
+        return fd;
+    }
+};
+
+/**
+ * Event loop serving many connections - each of them an RPC endpoint - from a single thread using epoll.
+ *
+ * Connections are added as connected stream sockets, that are switched to non-blocking mode. The
+ * reactor owns the endpoint objects and the sockets, they are destroyed (closed) when the connection
+ * is removed either explicitly or due to the remote end closing it, an IO error, malformed framing or
+ * a message that could not be parsed (see processingError).
+ *
+ * Events are level triggered and each readable connection is read once per poll (using a buffer
+ * shared by the connections), so that a busy connection can not starve the others.
+ *
+ * The _Connection_ type must be an Endpoint that has the EpollConnection as its transport adapter,
+ * like StlEndpoint<EpollConnection>.
+ */
+template<class Connection>
+class EpollReactor
+{
+    static constexpr int maxEvents = 256;
+
+    int epfd;
+    std::unique_ptr<char[]> rxBuffer;
+    size_t rxBufferSize;
+    std::unordered_map<Connection*, std::unique_ptr<Connection>> connections;
+    std::vector<Connection*> closing;
+
+    /**
+     * Read once from a readable connection and process the complete messages.
+     *
+     * Returns false if the connection needs to be closed.
+     */
+    inline bool serve(Connection* c)
+    {
+        ssize_t n;
+
+        do n = read(c->fd, rxBuffer.get(), rxBufferSize);
+        while(n < 0 && errno == EINTR);
+
+        if(n <= 0)
+            return n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+
+        {
+            std::lock_guard _(c->txLock);
+            c->deferred = true;
+        }
+
+        const bool ok = c->consume(rxBuffer.get(), (size_t)n, [this, c](InputAccessor a)
+        {
+            if(auto err = c->process(a))
+            {
+                c->error = err;
+
+                if(err == Errors::messageFormatError)
+                    remove(c);
+            }
+
+            return !c->closed;
+        });
+
+        return c->flush() && ok;
+    }
+
+public:
+    using InputAccessor = EpollConnection::InputAccessor;
+
+    static constexpr size_t defaultReceiveBufferSize = 64 * 1024;
+
+    EpollReactor(const EpollReactor&) = delete;
+    inline EpollReactor(size_t receiveBufferSize = defaultReceiveBufferSize):
+        epfd(epoll_create1(EPOLL_CLOEXEC)), rxBuffer(new char[receiveBufferSize]), rxBufferSize(receiveBufferSize)
+    {
+        if(epfd < 0)
+            fail("could not create epoll instance");
+    }
+
+    /**
+     * Destroys all the connections.
+     */
+    inline ~EpollReactor()
+    {
+        connections.clear();
+
+        if(0 <= epfd)
+            ::close(epfd);
+    }
+
+    /**
+     * Start serving a connected stream socket.
+     *
+     * The reactor takes ownership of the socket, it is closed if adding fails.
+     *
+     * Returns the endpoint object created for the connection, that can be used to provide
+     * methods and make calls, or nullptr on error.
+     */
+    inline Connection* add(int fd)
+    {
+        const auto flags = fcntl(fd, F_GETFL);
+
+        if(flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0)
+        {
+            ::close(fd);
+            return nullptr;
+        }
+
+        std::unique_ptr<Connection> c(new Connection(epfd, fd));
+        auto ret = c.get();
+
+        if(!c->attach())
+            return nullptr;
+
+        connections.emplace(ret, rpc::move(c));
+        return ret;
+    }
+
+    /**
+     * Stop serving a connection, it is destroyed at the end of the current (or next) poll.
+     *
+     * NOTE: can be called from a method invoked by the reactor (even for the connection it was invoked for).
+     */
+    inline void remove(Connection* c)
+    {
+        if(!c->closed)
+        {
+            c->closed = true;
+            closing.push_back(c);
+        }
+    }
+
+    /**
+     * Get the number of connections being served.
+     */
+    inline size_t size() const {
+        return connections.size() - closing.size();
+    }
+
+    /**
+     * Wait for events for at most _timeout_ milliseconds (-1 means indefinitely) and handle them.
+     *
+     * The callback is invoked with a reference to the endpoint object of each connection just before
+     * it is destroyed, regardless of whether it is removed explicitly or due to an error.
+     *
+     * Returns the number of events handled or -1 on error.
+     */
+    template<class C>
+    inline int poll(int timeout, C&& onClose)
+    {
+        epoll_event events[maxEvents];
+        int n;
+
+        do n = epoll_wait(epfd, events, maxEvents, timeout);
+        while(n < 0 && errno == EINTR);
+
+        for(int i = 0; i < n; i++)
+        {
+            auto c = static_cast<Connection*>(static_cast<EpollConnection*>(events[i].data.ptr));
+            const auto e = events[i].events;
+
+            if(c->closed)
+                continue;
+
+            if((e & (EPOLLERR | EPOLLHUP))
+            || ((e & EPOLLOUT) && !c->flush())
+            || ((e & EPOLLIN) && !serve(c))
+            || (!(e & EPOLLIN) && (e & EPOLLRDHUP)))
+                remove(c);
+        }
+
+        for(auto c: closing)
+        {
+            onClose(*c);
+            connections.erase(c);
+        }
+
+        closing.clear();
+        return n;
+    }
+
+    /**
+     * Wait for events and handle them, without notification about closed connections.
+     */
+    inline int poll(int timeout = -1) {
+        return poll(timeout, [](Connection&){});
+    }
+};
+
+}
+
+#endif /* _RPCEPOLLREACTOR_H_ */
@@ -3,30 +3,85 @@
 
 #include "RpcEndpoint.h"
 #include "RpcStlAdapters.h"
+#include "RpcBufferPool.h"
 
 #include <memory>
+#include <memory_resource>
 #include <list>
+#include <vector>
+#include <mutex>
 
 #include <cassert>
 #include <cstring>
+#include <cerrno>
 
 #include <unistd.h>
+#include <limits.h>
+#include <sys/uio.h>
 
 namespace rpc {
 
 class FdStreamAdapter;
+class IoUringAdapter;
+class EpollConnection;
+struct PreallocatedMemoryBufferStreamWriter;
+struct PreallocatedMemoryBufferStreamGrowingWriter;
 class PreallocatedMemoryBufferStreamWriterFactory;
 
+/**
+ * Message buffer, drawn from (and returned to) the process wide BufferPool.
+ *
+ * Small frames are stored inline in the object itself instead, so building and sending
+ * them involves no dynamic memory management at all.
+ */
 class PreallocatedMemoryBufferStream
 {
-    std::unique_ptr<char[]> buffer;
+public:
+    static constexpr size_t inlineCapacity = 64;
+
+private:
+    BufferPool::Buffer buffer;
+    size_t frameOffset = 0;
     char *start, *end;
+    char inlineData[inlineCapacity];
 
     friend FdStreamAdapter;
+    friend IoUringAdapter;
+    friend EpollConnection;
+    friend PreallocatedMemoryBufferStreamWriter;
+    friend PreallocatedMemoryBufferStreamGrowingWriter;
     friend PreallocatedMemoryBufferStreamWriterFactory;
 
-    inline PreallocatedMemoryBufferStream(std::unique_ptr<char[]> &&buffer, size_t size): 
-        buffer(std::move(buffer)), start(this->buffer.get()), end(this->buffer.get() + size) {}
+    /**
+     * Non-owning stream over a region of memory that is managed by someone else (e.g. a receive buffer).
+     */
+    inline PreallocatedMemoryBufferStream(char* start, char* end): start(start), end(end) {}
+
+    inline bool isInline() const {
+        return !buffer && inlineData <= start && start < inlineData + inlineCapacity;
+    }
+
+    /**
+     * Translate a pointer into the inline storage of another object to the same offset in this one.
+     */
+    inline char* relocate(const PreallocatedMemoryBufferStream& from, char* p) {
+        return inlineData + (p - from.inlineData);
+    }
+
+    /**
+     * Start of the storage owned by this object.
+     */
+    inline char* base() {
+        return buffer ? buffer.get() : inlineData;
+    }
+
+    /**
+     * Start of the whole frame (including the length header), it is not at the beginning 
+     * of the storage if the frame was built without knowing its length in advance.
+     */
+    inline char* frame() {
+        return base() + frameOffset;
+    }
     
 public:
     struct Accessor
@@ -66,19 +121,168 @@ public:
             ptr += size;
             return true;
         }
+
+        /**
+         * Get direct access to the next _size_ bytes, returns nullptr if there is not enough data left.
+         */
+        const char* peek(size_t size) const {
+            return (size <= size_t(end - ptr)) ? ptr : nullptr;
+        }
+
+        /**
+         * Get the number of bytes left.
+         */
+        size_t remaining() const {
+            return size_t(end - ptr);
+        }
+
+        /**
+         * Bulk write of raw bytes, used for arrays of values whose in-memory and serialized forms are identical.
+         */
+        bool write(const void* data, size_t length)
+        {
+            assert(length <= size_t(end - ptr));
+            memcpy(ptr, data, length);
+            ptr += length;
+            return true;
+        }
+
+        /**
+         * Bulk read of raw bytes, used for arrays of values whose in-memory and serialized forms are identical.
+         */
+        bool read(void* data, size_t length)
+        {
+            assert(length <= size_t(end - ptr));
+            memcpy(data, ptr, length);
+            ptr += length;
+            return true;
+        }
+    };
+
+    /**
+     * Accessor for untrusted input, running out of data is reported via the return values.
+     *
+     * A constant-size run of data (e.g. an aggregate or a collection of constant-size elements)
+     * can be validated using a single check via _run_, its contents are then processed using
+     * the unchecked accessor.
+     */
+    struct CheckedAccessor: Accessor
+    {
+        using Unchecked = Accessor;
+        using Accessor::Accessor;
+
+        /**
+         * Memory resource for the arguments deserialized from the stream (see Endpoint::process).
+         */
+        std::pmr::memory_resource* resource = nullptr;
+
+        /**
+         * Maximal number of elements of a collection deserialized from the stream (see Endpoint::setMaxCollectionSize).
+         */
+        uint32_t maxCollectionSize = uint32_t(-1);
+
+        inline uint32_t collectionLimit() const {
+            return maxCollectionSize;
+        }
+
+        inline void setCollectionLimit(uint32_t n) {
+            maxCollectionSize = n;
+        }
+
+        inline std::pmr::memory_resource* memoryResource() const {
+            return resource;
+        }
+
+        inline void setMemoryResource(std::pmr::memory_resource* r) {
+            resource = r;
+        }
+
+        template<class T>
+        bool write(const T& v) {
+            return sizeof(T) <= size_t(end - ptr) && Accessor::write(v);
+        }
+
+        template<class T>
+        bool read(T& v) {
+            return sizeof(T) <= size_t(end - ptr) && Accessor::read(v);
+        }
+
+        bool skip(size_t size) {
+            return size <= size_t(end - ptr) && Accessor::skip(size);
+        }
+
+        bool write(const void* data, size_t length) {
+            return length <= size_t(end - ptr) && Accessor::write(data, length);
+        }
+
+        bool read(void* data, size_t length) {
+            return length <= size_t(end - ptr) && Accessor::read(data, length);
+        }
+
+        /**
+         * Check that there is at least _length_ bytes of data available and pass an unchecked accessor
+         * limited to that range to the callback, then continue after the data processed by it.
+         */
+        template<class C>
+        bool run(size_t length, C&& c)
+        {
+            if(size_t(end - ptr) < length)
+                return false;
+
+            Unchecked u(ptr, ptr + length);
+
+            if(!c(u))
+                return false;
+
+            ptr = u.ptr;
+            return true;
+        }
     };
 
     inline auto access() {
-        return Accessor(start, end);
+        return CheckedAccessor(start, end);
+    }
+
+    /**
+     * Determine the total length of a frame for a given payload length, the length header 
+     * included. The header is one byte longer than that of the payload length itself if
+     * adding it pushes the total length into the next variable length encoding size class.
+     */
+    static inline constexpr size_t frameLength(size_t payload)
+    {
+        const auto header = VarUint4::size((uint32_t)payload);
+        return payload + header + (VarUint4::size((uint32_t)(payload + header)) != header);
+    }
+
+    inline PreallocatedMemoryBufferStream(PreallocatedMemoryBufferStream&& o) {
+        *this = rpc::move(o);
+    }
+
+    inline PreallocatedMemoryBufferStream& operator =(PreallocatedMemoryBufferStream&& o)
+    {
+        if(o.isInline())
+        {
+            buffer.reset();
+            memcpy(inlineData, o.inlineData, o.end - o.inlineData);
+            start = relocate(o, o.start);
+            end = relocate(o, o.end);
+        }
+        else
+        {
+            buffer = rpc::move(o.buffer);
+            start = o.start;
+            end = o.end;
+        }
+
+        frameOffset = o.frameOffset;
+        return *this;
     }
 
-    inline PreallocatedMemoryBufferStream(PreallocatedMemoryBufferStream&&) = default;
-    inline PreallocatedMemoryBufferStream& operator =(PreallocatedMemoryBufferStream&&) = default;
     inline PreallocatedMemoryBufferStream(size_t size):
-        buffer(new char[size]),
-        start(buffer.get()), end(buffer.get() + size)
+        buffer((inlineCapacity < size) ? BufferPool::allocate(size) : BufferPool::Buffer()),
+        start(base()), end(base() + size)
     {
-        auto a = access();
+        Accessor a(start, end);
         assert(size == (size_t)((uint32_t)size));
         auto lengthWriteOk = rpc::VarUint4::write(a, size);
         assert(lengthWriteOk);
@@ -88,8 +292,74 @@ public:
 
 struct PreallocatedMemoryBufferStreamWriter: PreallocatedMemoryBufferStream, PreallocatedMemoryBufferStream::Accessor {
     inline PreallocatedMemoryBufferStreamWriter(size_t s): 
-        PreallocatedMemoryBufferStream(s + VarUint4::size((uint32_t)s)),
-        PreallocatedMemoryBufferStream::Accessor(this->access()) {}
+        PreallocatedMemoryBufferStream(frameLength(s)),
+        PreallocatedMemoryBufferStream::Accessor(start, PreallocatedMemoryBufferStream::end) {}
+
+    inline PreallocatedMemoryBufferStreamWriter(PreallocatedMemoryBufferStreamWriter&& o):
+        PreallocatedMemoryBufferStream(static_cast<PreallocatedMemoryBufferStream&&>(o)),
+        PreallocatedMemoryBufferStream::Accessor(o.ptr, o.PreallocatedMemoryBufferStream::Accessor::end)
+    {
+        if(o.isInline())
+        {
+            ptr = relocate(o, o.ptr);
+            PreallocatedMemoryBufferStream::Accessor::end = relocate(o, o.PreallocatedMemoryBufferStream::Accessor::end);
+        }
+    }
+};
+
+/**
+ * Message writer for single-pass serialization, when the length of the message is not known in advance.
+ *
+ * The payload is written after a gap reserved for the longest possible length header. It starts in the
+ * inline storage and is moved to increasingly larger pooled buffers as needed. The length header is 
+ * filled in right in front of the payload when the message is done.
+ */
+struct PreallocatedMemoryBufferStreamGrowingWriter: PreallocatedMemoryBufferStream
+{
+    static constexpr size_t maxHeaderLength = 5;
+
+    char* ptr;
+
+    inline PreallocatedMemoryBufferStreamGrowingWriter(): PreallocatedMemoryBufferStream(nullptr, nullptr)
+    {
+        ptr = start = inlineData + maxHeaderLength;
+        end = inlineData + inlineCapacity;
+    }
+
+    inline PreallocatedMemoryBufferStreamGrowingWriter(PreallocatedMemoryBufferStreamGrowingWriter&& o):
+        PreallocatedMemoryBufferStream(static_cast<PreallocatedMemoryBufferStream&&>(o)),
+        ptr(o.isInline() ? relocate(o, o.ptr) : o.ptr) {}
+
+    /**
+     * Make room for at least _size_ more bytes.
+     */
+    inline void grow(size_t size)
+    {
+        const auto used = (size_t)(ptr - base()), offset = (size_t)(start - base());
+        const auto capacity = (size_t)(end - base()) * 2;
+        auto b = BufferPool::allocate((capacity < used + size) ? (used + size) : capacity);
+
+        memcpy(b.get(), base(), used);
+        start = b.get() + offset;
+        ptr = b.get() + used;
+        end = b.get() + b.get_deleter().capacity;
+        buffer = rpc::move(b);
+    }
+
+    template<class T>
+    inline bool write(const T& v) {
+        return write((const void*)&v, sizeof(T));
+    }
+
+    inline bool write(const void* data, size_t length)
+    {
+        if(size_t(end - ptr) < length)
+            grow(length);
+
+        memcpy(ptr, data, length);
+        ptr += length;
+        return true;
+    }
 };
 
 struct PreallocatedMemoryBufferStreamWriterFactory
@@ -100,65 +370,372 @@ struct PreallocatedMemoryBufferStreamWriterFactory
         return PreallocatedMemoryBufferStreamWriter(s); 
     }
 
+    static inline auto buildGrowing() {
+        return PreallocatedMemoryBufferStreamGrowingWriter(); 
+    }
+
+    /**
+     * Write the length header in front of the payload and release the stream.
+     */
+    static inline auto done(PreallocatedMemoryBufferStreamGrowingWriter &&w) 
+    {
+        const auto payload = (size_t)(w.ptr - w.start);
+        const auto length = PreallocatedMemoryBufferStream::frameLength(payload);
+        assert(length == (size_t)((uint32_t)length));
+
+        Accessor a(w.start - (length - payload), w.start);
+        VarUint4::write(a, (uint32_t)length);
+        w.frameOffset = (size_t)(w.start - (length - payload) - w.base());
+
+        auto stream = static_cast<PreallocatedMemoryBufferStream&&>(w);
+        stream.end = stream.start + payload;
+        return stream; 
+    }
+
     static inline auto done(PreallocatedMemoryBufferStreamWriter &&w) 
     {
+        const auto length = w.PreallocatedMemoryBufferStream::Accessor::end - w.PreallocatedMemoryBufferStream::start;
         auto stream = static_cast<PreallocatedMemoryBufferStream&&>(w);
-        auto accessor = static_cast<PreallocatedMemoryBufferStream::Accessor&&>(w);
-        stream.end = accessor.end;
+        stream.end = stream.start + length;
         return stream; 
     }
 };
 
+namespace detail
+{
+    /**
+     * Try to decode the length header at the beginning of a frame.
+     *
+     * Returns true if the header is complete, in this case the length of the header and the
+     * whole frame are stored via the reference arguments. The ok flag is cleared if the header
+     * is malformed (i.e. the encoded length is shorter than the header itself) or the frame
+     * would be longer than _maxFrameLength_ (so that the receiver does not need to buffer it).
+     */
+    static inline bool decodeFrameHeader(const char* p, size_t n, size_t &headerLength, size_t &frameLength, bool &ok, size_t maxFrameLength = size_t(-1))
+    {
+        VarUint4::Reader r;
+
+        for(auto i = 0u; i < n; i++)
+        {
+            if(r.process(p[i]))
+            {
+                const auto result = r.getResult();
+                headerLength = i + 1;
+
+                if(result < headerLength)
+                {
+                    ok = false;
+                    return false;
+                }
+
+                frameLength = headerLength + result - VarUint4::size((uint32_t)result);
+
+                if(maxFrameLength < frameLength)
+                {
+                    ok = false;
+                    return false;
+                }
+
+                return true;
+            }
+        }
+
+        return false;
+    }
+}
+
 class FdStreamAdapter
 {
     int wfd = -1, rfd = -1;
 
+    /**
+     * Outbound frames queued while the adapter is corked, flushed with a single gather write.
+     */
+    std::vector<PreallocatedMemoryBufferStream> txQueue;
+    std::vector<iovec> txIov;
+    size_t txQueuedBytes = 0, txMaxBytes = 64 * 1024, txMaxFrames = IOV_MAX;
+    unsigned int corkDepth = 0;
+    std::mutex txLock;
+
+    /**
+     * Receive buffer, filled using as large reads as possible and consumed frame by frame.
+     *
+     * The unprocessed data is in the [rxStart, rxEnd) range.
+     */
+    std::unique_ptr<char[]> rxBuffer;
+    size_t rxCapacity, rxStart = 0, rxEnd = 0, rxMaxFrame = size_t(-1);
+
+    /**
+     * Read as much data as fits into the receive buffer using a single read operation (retried
+     * if interrupted), after making sure that at least _required_ bytes of unprocessed data can
+     * be stored in it. Unprocessed data is moved to the beginning of the buffer and the buffer is
+     * enlarged if required.
+     *
+     * Returns false on end of file or IO error.
+     */
+    inline bool fill(size_t required)
+    {
+        const auto pending = rxEnd - rxStart;
+
+        if(rxCapacity < required)
+        {
+            std::unique_ptr<char[]> larger(new char[required]);
+            memcpy(larger.get(), rxBuffer.get() + rxStart, pending);
+            rxBuffer = std::move(larger);
+            rxCapacity = required;
+            rxStart = 0;
+            rxEnd = pending;
+        }
+        else if(rxStart)
+        {
+            memmove(rxBuffer.get(), rxBuffer.get() + rxStart, pending);
+            rxStart = 0;
+            rxEnd = pending;
+        }
+
+        while(true)
+        {
+            const auto n = read(rfd, rxBuffer.get() + rxEnd, rxCapacity - rxEnd);
+
+            if(n > 0)
+            {
+                rxEnd += n;
+                return true;
+            }
+
+            if(n < 0 && errno == EINTR)
+                continue;
+
+            return false;
+        }
+    }
+
+    /**
+     * Write the contents of the io vector fully, continuing after partial writes.
+     *
+     * NOTE: the io vector is modified in the process.
+     */
+    inline bool writeFully(iovec* iov, size_t n)
+    {
+        while(n)
+        {
+            const auto written = writev(wfd, iov, (int)n);
+
+            if(written < 0)
+            {
+                if(errno == EINTR)
+                    continue;
+
+                return false;
+            }
+
+            auto remaining = (size_t)written;
+
+            for(; n && remaining >= iov->iov_len; n--)
+                remaining -= (iov++)->iov_len;
+
+            if(n)
+            {
+                iov->iov_base = (char*)iov->iov_base + remaining;
+                iov->iov_len -= remaining;
+            }
+        }
+
+        return true;
+    }
+
+    /**
+     * Send all the queued frames using a single gather write (unless it is a partial write).
+     *
+     * NOTE: must be called with the transmit lock held.
+     */
+    inline bool flushQueue()
+    {
+        txIov.clear();
+
+        for(auto &f: txQueue)
+        {
+            auto ptr = f.frame();
+            txIov.push_back({ptr, (size_t)(f.end - ptr)});
+        }
+
+        const bool ret = writeFully(txIov.data(), txIov.size());
+        txQueue.clear();
+        txQueuedBytes = 0;
+        return ret;
+    }
+
 public:
-    using InputAccessor = PreallocatedMemoryBufferStream::Accessor;
+    static constexpr size_t defaultReceiveBufferSize = 64 * 1024;
+
+    using InputAccessor = PreallocatedMemoryBufferStream::CheckedAccessor;
 
     FdStreamAdapter(const FdStreamAdapter&) = delete;
-    inline FdStreamAdapter(int wfd, int rfd): wfd(wfd), rfd(rfd) {}
+    inline FdStreamAdapter(int wfd, int rfd, size_t receiveBufferSize = defaultReceiveBufferSize):
+        wfd(wfd), rfd(rfd), rxBuffer(new char[receiveBufferSize]), rxCapacity(receiveBufferSize) {}
 
     inline auto messageFactory() {
     	return PreallocatedMemoryBufferStreamWriterFactory{};
     }
 
+    /**
+     * Set the maximal length of an inbound frame (including the length header).
+     *
+     * Receiving fails as soon as the header of a longer frame is seen, so the buffer is
+     * never enlarged beyond this size by a peer announcing a huge message.
+     */
+    inline void setMaxMessageSize(size_t length) {
+        rxMaxFrame = length;
+    }
+
+    /**
+     * Send a message.
+     *
+     * If the adapter is not corked the message is written immediately, otherwise it is queued 
+     * until the adapter is uncorked, flushed explicitly or the queue limits are reached.
+     *
+     * Returns false on IO error.
+     */
     bool send(PreallocatedMemoryBufferStream&& data)
     {
-        auto ptr = data.buffer.get();
-        auto len = data.end - ptr;
-        return write(wfd, ptr, len) == len;
+        std::lock_guard _(txLock);
+
+        auto ptr = data.frame();
+        auto len = (size_t)(data.end - ptr);
+
+        if(!corkDepth)
+        {
+            iovec iov{ptr, len};
+            return writeFully(&iov, 1);
+        }
+
+        txQueue.push_back(std::move(data));
+        txQueuedBytes += len;
+
+        if(txMaxBytes <= txQueuedBytes || txMaxFrames <= txQueue.size())
+            return flushQueue();
+
+        return true;
+    }
+
+    /**
+     * Start queueing outbound messages instead of writing them one by one.
+     *
+     * Corking can be nested, queued messages are sent when the outermost cork is removed. It 
+     * applies to the whole adapter, i.e. to messages sent from any thread.
+     */
+    inline void cork()
+    {
+        std::lock_guard _(txLock);
+        corkDepth++;
+    }
+
+    /**
+     * Remove a cork, flushes the queued messages if it was the outermost one.
+     *
+     * Returns false on IO error.
+     */
+    inline bool uncork()
+    {
+        std::lock_guard _(txLock);
+        assert(corkDepth);
+
+        if(!--corkDepth && !txQueue.empty())
+            return flushQueue();
+
+        return true;
+    }
+
+    /**
+     * Send the queued messages immediately, regardless of the corking state.
+     *
+     * Returns false on IO error.
+     */
+    inline bool flush()
+    {
+        std::lock_guard _(txLock);
+        return txQueue.empty() || flushQueue();
     }
 
+    /**
+     * Set the queue limits that trigger an implicit flush while the adapter is corked.
+     */
+    inline void setCorkLimits(size_t maxBytes, size_t maxFrames)
+    {
+        std::lock_guard _(txLock);
+        txMaxBytes = maxBytes;
+        txMaxFrames = (maxFrames && maxFrames < IOV_MAX) ? maxFrames : IOV_MAX;
+    }
+
+    /**
+     * Scope guard that keeps the adapter corked during its lifetime.
+     *
+     * Useful for example in a method that issues several calls, so that they go out using a single system call.
+     *
+     * NOTE: errors of the final flush are not reported, call flush explicitly before the end of the scope if needed.
+     */
+    class Cork
+    {
+        FdStreamAdapter &adapter;
+
+    public:
+        inline Cork(FdStreamAdapter &adapter): adapter(adapter) { adapter.cork(); }
+        inline ~Cork() { adapter.uncork(); }
+        Cork(const Cork&) = delete;
+    };
+
+    /**
+     * Receive messages and pass them to the callback one by one.
+     *
+     * Blocks until at least one complete message is available, then dispatches every complete
+     * message that has been buffered so far - without further system calls. Messages are passed
+     * to the callback as non-owning streams that point into the receive buffer, so they are valid
+     * only during the invocation of the callback.
+     *
+     * Returns false on IO error, malformed framing or if the callback returns false, in the
+     * latter case the remaining buffered messages are processed by the next invocation.
+     */
     template<class C>
     bool receive(C&& cb)
     {
-        uint32_t messageLength;
-        VarUint4::Reader r;
+        bool dispatched = false;
 
         while(true)
         {
-            char c;
-            if(read(rfd, &c, 1) != 1)
-                return false;
+            size_t headerLength, required;
+            bool ok = true;
 
-            if(r.process(c))
+            if(detail::decodeFrameHeader(rxBuffer.get() + rxStart, rxEnd - rxStart, headerLength, required, ok, rxMaxFrame))
             {
-                auto result = r.getResult();
-                messageLength = result - VarUint4::size((uint32_t)result);
-                break;
-            }
-        }
+                if(required <= rxEnd - rxStart)
+                {
+                    auto frame = rxBuffer.get() + rxStart;
+                    rxStart += required;
+                    dispatched = true;
 
-        std::unique_ptr<char[]> buffer(new char[messageLength]);
+                    if(!cb(PreallocatedMemoryBufferStream(frame + headerLength, frame + required)))
+                        return false;
 
-        if(read(rfd, buffer.get(), messageLength) != messageLength)
-            return false;
+                    continue;
+                }
+            }
+            else if(!ok)
+            {
+                return false;
+            }
+            else
+            {
+                required = rxEnd - rxStart + 1;
+            }
+
+            if(dispatched)
+                return true;
 
-        return cb(PreallocatedMemoryBufferStream(std::move(buffer), messageLength));
+            if(!fill(required))
+                return false;
+        }
     }
 };
-
 }
 
 #endif /* _RPCFDSTREAMADAPTER_H_ */
@@ -0,0 +1,790 @@
+#ifndef _RPCIOURINGADAPTER_H_
+#define _RPCIOURINGADAPTER_H_
+
+#include "RpcFail.h"
+#include "RpcFdStreamAdapter.h"
+
+#include <memory>
+#include <vector>
+#include <mutex>
+
+#include <cassert>
+#include <cstring>
+#include <cerrno>
+
+#include <unistd.h>
+#include <limits.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+namespace rpc {
+
+namespace detail
+{
+    /**
+     * Minimal io_uring instance wrapper: ring setup, submission queue entry allocation,
+     * submission and completion queue access, using the raw system call interface.
+     */
+    class IoUring
+    {
+        int fd = -1;
+        void *sqRing = MAP_FAILED, *cqRing = MAP_FAILED;
+        size_t sqRingSize = 0, cqRingSize = 0;
+        io_uring_sqe* sqes = (io_uring_sqe*)MAP_FAILED;
+        size_t sqesSize = 0;
+
+        unsigned *sqHead, *sqTail, *sqMask, *sqArray, sqEntries;
+        unsigned *cqHead, *cqTail, *cqMask;
+        io_uring_cqe* cqes;
+
+        unsigned sqLocalTail = 0, toSubmit = 0;
+
+        template<class T>
+        static inline T* at(void* base, unsigned offset) {
+            return reinterpret_cast<T*>(static_cast<char*>(base) + offset);
+        }
+
+    public:
+        IoUring(const IoUring&) = delete;
+        inline IoUring() = default;
+
+        inline ~IoUring() {
+            shutdown();
+        }
+
+        /**
+         * Release the instance, cancelling the operations still in flight.
+         */
+        inline void shutdown()
+        {
+            if(sqes != MAP_FAILED)
+                munmap(sqes, sqesSize);
+
+            if(cqRing != MAP_FAILED && cqRing != sqRing)
+                munmap(cqRing, cqRingSize);
+
+            if(sqRing != MAP_FAILED)
+                munmap(sqRing, sqRingSize);
+
+            if(fd >= 0)
+                close(fd);
+
+            sqes = (io_uring_sqe*)MAP_FAILED;
+            sqRing = cqRing = MAP_FAILED;
+            fd = -1;
+        }
+
+        inline bool init(unsigned entries)
+        {
+            io_uring_params p;
+            memset(&p, 0, sizeof(p));
+
+            fd = (int)syscall(__NR_io_uring_setup, entries, &p);
+
+            if(fd < 0)
+                return false;
+
+            sqRingSize = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+            cqRingSize = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+
+            if(p.features & IORING_FEAT_SINGLE_MMAP)
+                sqRingSize = cqRingSize = (sqRingSize < cqRingSize) ? cqRingSize : sqRingSize;
+
+            sqRing = mmap(nullptr, sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+
+            if(sqRing == MAP_FAILED)
+                return false;
+
+            if(p.features & IORING_FEAT_SINGLE_MMAP)
+                cqRing = sqRing;
+            else if((cqRing = mmap(nullptr, cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING)) == MAP_FAILED)
+                return false;
+
+            sqesSize = p.sq_entries * sizeof(io_uring_sqe);
+            sqes = (io_uring_sqe*)mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+
+            if(sqes == MAP_FAILED)
+                return false;
+
+            sqHead = at<unsigned>(sqRing, p.sq_off.head);
+            sqTail = at<unsigned>(sqRing, p.sq_off.tail);
+            sqMask = at<unsigned>(sqRing, p.sq_off.ring_mask);
+            sqArray = at<unsigned>(sqRing, p.sq_off.array);
+            sqEntries = p.sq_entries;
+            sqLocalTail = *sqTail;
+
+            cqHead = at<unsigned>(cqRing, p.cq_off.head);
+            cqTail = at<unsigned>(cqRing, p.cq_off.tail);
+            cqMask = at<unsigned>(cqRing, p.cq_off.ring_mask);
+            cqes = at<io_uring_cqe>(cqRing, p.cq_off.cqes);
+            return true;
+        }
+
+        inline int registerResource(unsigned opcode, const void* arg, unsigned count) {
+            return (int)syscall(__NR_io_uring_register, fd, opcode, arg, count);
+        }
+
+        /**
+         * Get a cleared submission queue entry, or nullptr if the queue is full.
+         */
+        inline io_uring_sqe* getSqe()
+        {
+            if(sqLocalTail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE) >= sqEntries)
+                return nullptr;
+
+            const auto idx = sqLocalTail++ & *sqMask;
+            sqArray[idx] = idx;
+            toSubmit++;
+
+            auto ret = &sqes[idx];
+            memset(ret, 0, sizeof(*ret));
+            return ret;
+        }
+
+        /**
+         * Submit the prepared entries and optionally wait for a number of completions.
+         */
+        inline bool submit(unsigned waitFor = 0)
+        {
+            __atomic_store_n(sqTail, sqLocalTail, __ATOMIC_RELEASE);
+
+            while(toSubmit || waitFor)
+            {
+                const auto n = syscall(__NR_io_uring_enter, fd, toSubmit, waitFor, waitFor ? IORING_ENTER_GETEVENTS : 0, nullptr, 0);
+
+                if(n < 0)
+                {
+                    if(errno == EINTR)
+                        continue;
+
+                    return false;
+                }
+
+                toSubmit -= (unsigned)n;
+                waitFor = 0;
+            }
+
+            return true;
+        }
+
+        /**
+         * Get the next completion queue entry if there is any (without consuming it).
+         */
+        inline io_uring_cqe* peek()
+        {
+            const auto head = *cqHead;
+
+            if(head == __atomic_load_n(cqTail, __ATOMIC_ACQUIRE))
+                return nullptr;
+
+            return &cqes[head & *cqMask];
+        }
+
+        /**
+         * Consume the completion queue entry returned by peek.
+         */
+        inline void advance() {
+            __atomic_store_n(cqHead, *cqHead + 1, __ATOMIC_RELEASE);
+        }
+    };
+}
+
+/**
+ * Message transport adapter for stream sockets, using Linux io_uring.
+ *
+ * It uses the same framing as the FdStreamAdapter, so the two are interoperable.
+ *
+ * The receive side keeps a multishot receive operation in flight, that stores data into
+ * buffers picked by the kernel from a group of provided buffers. Complete frames are dispatched
+ * right from these buffers, only frames spanning multiple buffers are reassembled.
+ *
+ * The send side serializes messages directly into a pool of registered (fixed) buffers.
+ * Messages are submitted either immediately or - if the adapter is corked - as a batch when
+ * the outermost cork is removed. A batch is written using a single gather write operation,
+ * because separate operations per message would need to be linked to be kept in order and
+ * they would still result in separate socket writes. Only one batch is in flight at a time,
+ * partial writes are resubmitted.
+ *
+ * NOTE: sending and receiving uses separate rings, so that they can be done on different threads.
+ */
+class IoUringAdapter
+{
+    static constexpr unsigned short bufferGroup = 0;
+    static constexpr uint64_t recvTag = 0, provideTag = 1;
+
+    int sfd = -1;
+
+    struct Outgoing
+    {
+        char* data;
+        size_t length;
+        int slot = -1;
+        BufferPool::Buffer scratch;
+    };
+
+    detail::IoUring txRing, rxRing;
+
+    char* txBuffers = (char*)MAP_FAILED;
+    size_t txSlotSize, txSlotCount;
+    std::vector<int> txFreeSlots;
+    size_t txMaxBatch;
+    std::vector<Outgoing> txQueued, txInflight;
+    std::vector<iovec> txIov;
+    size_t txIovPos = 0;
+    unsigned int corkDepth = 0;
+    std::mutex txLock;
+
+    char* rxBuffers = (char*)MAP_FAILED;
+    size_t rxBufferSize, rxBufferCount;
+    std::vector<char> rxPartial, rxCarry;
+    size_t rxMaxFrame = size_t(-1);
+    bool rxArmed = false;
+
+    static inline void* mapAnonymous(size_t size) {
+        return mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+    }
+
+    /**
+     * Get a submission queue entry on the receive ring, submitting the pending ones if it is full.
+     */
+    inline io_uring_sqe* getRxSqe()
+    {
+        if(auto sqe = rxRing.getSqe())
+            return sqe;
+
+        return rxRing.submit() ? rxRing.getSqe() : nullptr;
+    }
+
+    /**
+     * Hand consecutive receive buffers (back) to the kernel.
+     *
+     * The request is submitted along with the next batch, its completion is only reported on failure.
+     */
+    inline bool provideBuffers(unsigned short id, unsigned short count)
+    {
+        auto sqe = getRxSqe();
+
+        if(!sqe)
+            return false;
+
+        sqe->opcode = IORING_OP_PROVIDE_BUFFERS;
+        sqe->fd = count;
+        sqe->addr = (uint64_t)(rxBuffers + id * rxBufferSize);
+        sqe->len = (uint32_t)rxBufferSize;
+        sqe->off = id;
+        sqe->buf_group = bufferGroup;
+        sqe->flags = IOSQE_CQE_SKIP_SUCCESS;
+        sqe->user_data = provideTag;
+        return true;
+    }
+
+    inline bool arm()
+    {
+        auto sqe = getRxSqe();
+
+        if(!sqe)
+            return false;
+
+        sqe->opcode = IORING_OP_RECV;
+        sqe->fd = sfd;
+        sqe->ioprio = IORING_RECV_MULTISHOT;
+        sqe->flags = IOSQE_BUFFER_SELECT;
+        sqe->buf_group = bufferGroup;
+        sqe->user_data = recvTag;
+        return rxArmed = true;
+    }
+
+    /**
+     * Process a chunk of received data, dispatch complete frames, keep the incomplete one.
+     *
+     * If the callback returns false, the rest of the data is saved for the next receive call.
+     */
+    template<class C>
+    inline bool consume(const char* p, size_t n, C&& cb, bool &dispatched)
+    {
+        while(n)
+        {
+            size_t headerLength, frameLength;
+            bool ok = true;
+
+            if(!rxPartial.empty())
+            {
+                if(!detail::decodeFrameHeader(rxPartial.data(), rxPartial.size(), headerLength, frameLength, ok, rxMaxFrame))
+                {
+                    if(!ok)
+                        return false;
+
+                    rxPartial.push_back(*p++);
+                    n--;
+                    continue;
+                }
+
+                const auto missing = frameLength - rxPartial.size();
+                const auto taken = (missing < n) ? missing : n;
+                rxPartial.insert(rxPartial.end(), p, p + taken);
+                p += taken;
+                n -= taken;
+
+                if(rxPartial.size() == frameLength)
+                {
+                    auto frame = rpc::move(rxPartial);
+                    rxPartial.clear();
+                    dispatched = true;
+
+                    auto start = frame.data() + headerLength, end = frame.data() + frameLength;
+
+                    if(!cb(PreallocatedMemoryBufferStream(start, end)))
+                    {
+                        rxCarry.assign(p, p + n);
+                        return false;
+                    }
+
+                    rxPartial = rpc::move(frame);
+                    rxPartial.clear();
+                }
+            }
+            else if(detail::decodeFrameHeader(p, n, headerLength, frameLength, ok, rxMaxFrame) && frameLength <= n)
+            {
+                auto start = const_cast<char*>(p) + headerLength, end = const_cast<char*>(p) + frameLength;
+                p += frameLength;
+                n -= frameLength;
+                dispatched = true;
+
+                if(!cb(PreallocatedMemoryBufferStream(start, end)))
+                {
+                    rxCarry.assign(p, p + n);
+                    return false;
+                }
+            }
+            else if(!ok)
+            {
+                return false;
+            }
+            else
+            {
+                rxPartial.assign(p, p + n);
+                break;
+            }
+        }
+
+        return true;
+    }
+
+    /**
+     * Submit the not yet written part of the batch in flight.
+     *
+     * A single message in a registered buffer is written using a fixed buffer write operation,
+     * otherwise the whole batch is written using a single gather write operation, so that the
+     * messages are written in order and get coalesced by the kernel.
+     *
+     * NOTE: must be called with the transmit lock held.
+     */
+    inline bool submitInflight()
+    {
+        auto sqe = txRing.getSqe();
+        assert(sqe);
+
+        auto iov = txIov.data() + txIovPos;
+        const auto n = txIov.size() - txIovPos;
+
+        sqe->fd = sfd;
+        sqe->off = (uint64_t)-1;
+
+        if(txInflight.size() == 1 && 0 <= txInflight[0].slot)
+        {
+            sqe->opcode = IORING_OP_WRITE_FIXED;
+            sqe->addr = (uint64_t)iov->iov_base;
+            sqe->len = (uint32_t)iov->iov_len;
+            sqe->buf_index = 0;
+        }
+        else
+        {
+            sqe->opcode = IORING_OP_WRITEV;
+            sqe->addr = (uint64_t)iov;
+            sqe->len = (uint32_t)n;
+        }
+
+        return txRing.submit();
+    }
+
+    /**
+     * Wait for the batch in flight to be written, resubmit the remainder after partial writes.
+     *
+     * NOTE: must be called with the transmit lock held.
+     */
+    inline bool completeInflight()
+    {
+        while(!txInflight.empty())
+        {
+            auto cqe = txRing.peek();
+
+            if(!cqe)
+            {
+                if(!txRing.submit(1))
+                    return false;
+
+                continue;
+            }
+
+            const auto res = cqe->res;
+            txRing.advance();
+
+            bool ok = 0 < res;
+
+            if(ok)
+            {
+                auto remaining = (size_t)res;
+
+                for(; txIovPos < txIov.size() && remaining >= txIov[txIovPos].iov_len; txIovPos++)
+                    remaining -= txIov[txIovPos].iov_len;
+
+                if(txIovPos < txIov.size())
+                {
+                    auto &iov = txIov[txIovPos];
+                    iov.iov_base = (char*)iov.iov_base + remaining;
+                    iov.iov_len -= remaining;
+
+                    if(submitInflight())
+                        continue;
+
+                    ok = false;
+                }
+            }
+
+            for(auto &o: txInflight)
+                if(0 <= o.slot)
+                    txFreeSlots.push_back(o.slot);
+
+            txInflight.clear();
+
+            if(!ok)
+                return false;
+        }
+
+        return true;
+    }
+
+    /**
+     * Submit the queued messages after the previous batch is completed.
+     *
+     * NOTE: must be called with the transmit lock held.
+     */
+    inline bool flushQueue()
+    {
+        if(!completeInflight())
+        {
+            for(auto &o: txQueued)
+                if(0 <= o.slot)
+                    txFreeSlots.push_back(o.slot);
+
+            txQueued.clear();
+            return false;
+        }
+
+        if(txQueued.empty())
+            return true;
+
+        std::swap(txInflight, txQueued);
+        txIov.clear();
+        txIovPos = 0;
+
+        for(auto &o: txInflight)
+            txIov.push_back({o.data, o.length});
+
+        return submitInflight();
+    }
+
+public:
+    using InputAccessor = PreallocatedMemoryBufferStream::CheckedAccessor;
+
+    /**
+     * Outbound message being serialized directly into a registered buffer.
+     *
+     * Holds the transmit lock of the adapter until it is sent or destroyed. If the message does
+     * not fit into a registered buffer it is serialized into a temporary one.
+     */
+    class Writer: public PreallocatedMemoryBufferStream::Accessor
+    {
+        friend IoUringAdapter;
+        std::unique_lock<std::mutex> lock;
+        IoUringAdapter* adapter;
+        Outgoing message;
+
+        inline Writer(IoUringAdapter* adapter): lock(adapter->txLock), adapter(adapter) {}
+
+    public:
+        inline Writer(Writer&&) = default;
+
+        inline ~Writer()
+        {
+            if(lock.owns_lock() && 0 <= message.slot)
+                adapter->txFreeSlots.push_back(message.slot);
+        }
+    };
+
+    struct MessageFactory
+    {
+        IoUringAdapter* adapter;
+
+        inline auto build(size_t s) {
+            return adapter->reserve(s);
+        }
+
+        static inline auto done(Writer &&w) {
+            return rpc::move(w);
+        }
+    };
+
+    IoUringAdapter(const IoUringAdapter&) = delete;
+
+    /**
+     * Set up the rings and buffers for a connected stream socket.
+     */
+    inline IoUringAdapter(int sfd, size_t sendSlots = 64, size_t sendSlotSize = 4096, size_t recvBuffers = 64, size_t recvBufferSize = 16 * 1024):
+        sfd(sfd), txSlotSize(sendSlotSize), txSlotCount(sendSlots), txMaxBatch((sendSlots < IOV_MAX) ? sendSlots : IOV_MAX), rxBufferSize(recvBufferSize), rxBufferCount(recvBuffers)
+    {
+        assert(recvBuffers && recvBuffers <= 32768);
+
+        if(!txRing.init(8) || !rxRing.init(64))
+        {
+            fail("could not set up io_uring instance");
+            return;
+        }
+
+        txBuffers = (char*)mapAnonymous(sendSlots * sendSlotSize);
+        rxBuffers = (char*)mapAnonymous(recvBuffers * recvBufferSize);
+
+        if(txBuffers == MAP_FAILED || rxBuffers == MAP_FAILED)
+        {
+            fail("could not allocate io_uring buffers");
+            return;
+        }
+
+        const iovec fixed{txBuffers, sendSlots * sendSlotSize};
+
+        if(txRing.registerResource(IORING_REGISTER_BUFFERS, &fixed, 1) < 0)
+        {
+            fail("could not register io_uring send buffers");
+            return;
+        }
+
+        if(!provideBuffers(0, (unsigned short)recvBuffers) || !rxRing.submit())
+        {
+            fail("could not provide io_uring receive buffers");
+            return;
+        }
+
+        for(auto i = (int)sendSlots; i--;)
+            txFreeSlots.push_back(i);
+
+        txQueued.reserve(sendSlots);
+        txInflight.reserve(sendSlots);
+        txIov.reserve(txMaxBatch);
+    }
+
+    inline ~IoUringAdapter()
+    {
+        {
+            std::lock_guard _(txLock);
+            corkDepth = 0;
+            flushQueue();
+            completeInflight();
+        }
+
+        // The buffers must not be released while the kernel may still access them.
+        txRing.shutdown();
+        rxRing.shutdown();
+
+        if(txBuffers != MAP_FAILED)
+            munmap(txBuffers, txSlotCount * txSlotSize);
+
+        if(rxBuffers != MAP_FAILED)
+            munmap(rxBuffers, rxBufferCount * rxBufferSize);
+    }
+
+    inline auto messageFactory() {
+        return MessageFactory{this};
+    }
+
+    /**
+     * Set the maximal length of an inbound frame (including the length header), receiving
+     * fails if the peer announces a longer one.
+     */
+    inline void setMaxMessageSize(size_t length) {
+        rxMaxFrame = length;
+    }
+
+    /**
+     * Allocate a registered buffer for a message (waiting for one to be freed if needed).
+     */
+    inline Writer reserve(size_t length)
+    {
+        Writer w(this);
+        const auto frameLength = PreallocatedMemoryBufferStream::frameLength(length);
+
+        if(frameLength <= txSlotSize)
+        {
+            if(txFreeSlots.empty())
+                flushQueue();
+
+            if(txFreeSlots.empty())
+                completeInflight();
+        }
+
+        if(frameLength <= txSlotSize && !txFreeSlots.empty())
+        {
+            w.message.slot = txFreeSlots.back();
+            txFreeSlots.pop_back();
+            w.message.data = txBuffers + w.message.slot * txSlotSize;
+        }
+        else
+        {
+            w.message.slot = -1;
+            w.message.scratch = BufferPool::allocate(frameLength);
+            w.message.data = w.message.scratch.get();
+        }
+
+        w.message.length = frameLength;
+        w.ptr = w.message.data;
+        w.end = w.message.data + frameLength;
+
+        auto lengthWriteOk = VarUint4::write(w, (uint32_t)frameLength);
+        assert(lengthWriteOk);
+        return w;
+    }
+
+    /**
+     * Send a message.
+     *
+     * If the adapter is not corked the message is submitted immediately, otherwise it is queued until
+     * the adapter is uncorked, flushed explicitly or there are no more registered buffers available.
+     *
+     * Returns false on IO error (possibly of an earlier submitted message).
+     */
+    inline bool send(Writer&& w)
+    {
+        auto lock = rpc::move(w.lock);
+
+        txQueued.push_back(rpc::move(w.message));
+
+        if(!corkDepth || txMaxBatch <= txQueued.size())
+            return flushQueue();
+
+        return true;
+    }
+
+    /**
+     * Start queueing outbound messages, to be submitted as a single batch.
+     *
+     * Corking can be nested, the queued messages are submitted when the outermost cork is removed.
+     */
+    inline void cork()
+    {
+        std::lock_guard _(txLock);
+        corkDepth++;
+    }
+
+    /**
+     * Remove a cork, submits the queued messages if it was the outermost one.
+     *
+     * Returns false on IO error.
+     */
+    inline bool uncork()
+    {
+        std::lock_guard _(txLock);
+        assert(corkDepth);
+
+        if(!--corkDepth)
+            return flushQueue();
+
+        return true;
+    }
+
+    /**
+     * Submit the queued messages and wait for all submitted messages to be written.
+     *
+     * Returns false on IO error.
+     */
+    inline bool flush()
+    {
+        std::lock_guard _(txLock);
+        return flushQueue() && completeInflight();
+    }
+
+    /**
+     * Receive messages and pass them to the callback one by one.
+     *
+     * Blocks until at least one complete message is available, then dispatches every complete
+     * message from the completions available without further system calls. Messages are passed
+     * to the callback as non-owning streams, they are only valid during the invocation of the
+     * callback.
+     *
+     * Returns false on IO error, end of stream, malformed framing or if the callback returns false.
+     */
+    template<class C>
+    bool receive(C&& cb)
+    {
+        bool dispatched = false;
+
+        if(!rxCarry.empty())
+        {
+            auto carried = rpc::move(rxCarry);
+            rxCarry.clear();
+
+            if(!consume(carried.data(), carried.size(), cb, dispatched))
+                return false;
+
+            if(dispatched)
+                return true;
+        }
+
+        while(true)
+        {
+            if(!rxArmed && !arm())
+                return false;
+
+            auto cqe = rxRing.peek();
+
+            if(!cqe)
+            {
+                if(dispatched)
+                    return true;
+
+                if(!rxRing.submit(1))
+                    return false;
+
+                continue;
+            }
+
+            const auto res = cqe->res;
+            const auto flags = cqe->flags;
+            const auto tag = cqe->user_data;
+            rxRing.advance();
+
+            if(tag == provideTag)
+                return false;
+
+            if(!(flags & IORING_CQE_F_MORE))
+                rxArmed = false;
+
+            if(flags & IORING_CQE_F_BUFFER)
+            {
+                const auto id = (unsigned short)(flags >> IORING_CQE_BUFFER_SHIFT);
+                const bool ok = 0 < res && consume(rxBuffers + id * rxBufferSize, (size_t)res, cb, dispatched);
+
+                if(!provideBuffers(id, 1) || !ok)
+                    return false;
+            }
+            else if(res != -ENOBUFS)
+            {
+                return false;
+            }
+        }
+    }
+};
+
+}
+
+#endif /* _RPCIOURINGADAPTER_H_ */
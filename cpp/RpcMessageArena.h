@@ -0,0 +1,57 @@
+#ifndef _RPCMESSAGEARENA_H_
+#define _RPCMESSAGEARENA_H_
+
+#include <memory>
+#include <memory_resource>
+
+#include <cstddef>
+
+namespace rpc {
+
+/**
+ * Per-message memory arena for deserializing the arguments of incoming calls (see Endpoint::process).
+ *
+ * Allocations are served by bumping a pointer in an initial buffer owned by the arena, and if that
+ * runs out from larger blocks obtained from an upstream pool. Deallocation of individual objects is
+ * a no-op, all the memory is released at once by _reset_ after the message has been processed. The
+ * pool keeps the blocks, so in steady state processing a message does not touch the heap at all.
+ *
+ * Arguments need to use allocators that can be constructed from a std::pmr::memory_resource pointer
+ * (e.g. std::pmr::vector<std::pmr::string>) in order to benefit from the arena.
+ *
+ * NOTE: it is not thread-safe, each thread processing messages needs to use a separate arena.
+ */
+class MessageArena
+{
+    std::pmr::unsynchronized_pool_resource upstream;
+    std::unique_ptr<std::byte[]> initial;
+    std::pmr::monotonic_buffer_resource monotonic;
+
+public:
+    static constexpr size_t defaultInitialSize = 4 * 1024;
+    static constexpr size_t largestPooledBlock = 1024 * 1024;
+
+    MessageArena(const MessageArena&) = delete;
+    inline MessageArena(size_t initialSize = defaultInitialSize):
+        upstream(std::pmr::pool_options{0, largestPooledBlock}),
+        initial(new std::byte[initialSize]),
+        monotonic(initial.get(), initialSize, &upstream) {}
+
+    /**
+     * Get the memory resource to allocate from.
+     */
+    inline std::pmr::memory_resource* resource() {
+        return &monotonic;
+    }
+
+    /**
+     * Release everything allocated since the last reset.
+     */
+    inline void reset() {
+        monotonic.release();
+    }
+};
+
+}
+
+#endif /* _RPCMESSAGEARENA_H_ */
@@ -0,0 +1,182 @@
+#ifndef _RPCPERFECTHASH_H_
+#define _RPCPERFECTHASH_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace rpc {
+
+namespace detail
+{
+    /**
+     * Perfect hash table of a set of 64 bit keys (like symbol hashes) with 32 bit values, built at compile time.
+     *
+     * It uses the "hash and displace" method: the keys are mixed with a seed and distributed into buckets
+     * (of two keys on average) by the high bits of the result, then the buckets - the largest ones first -
+     * are assigned a displacement that is xor-ed onto the low bits of their keys, so that all of them end up
+     * in free slots of the table. If that is not possible for a bucket, it is retried with the next seed.
+     *
+     * The table has at least twice as many slots as there are keys, so a displacement is usually found
+     * after a few attempts, and a lookup is a single probe: the slot is calculated from the key and the
+     * displacement of its bucket, then the key stored in it is compared with the one looked up.
+     *
+     * NOTE: the keys must be unique, otherwise the table can not be built (see _ok_), and the values
+     *       must not be all ones (that marks the empty slots).
+     */
+    template<size_t n>
+    class PerfectHash
+    {
+        static_assert(n < (size_t(1) << 20), "too many keys for a perfect hash table");
+
+        static constexpr inline unsigned int bitsFor(size_t count)
+        {
+            unsigned int ret = 1;
+
+            while((size_t(1) << ret) < count)
+                ret++;
+
+            return ret;
+        }
+
+        static constexpr unsigned int tableBits = bitsFor(2 * n), bucketBits = tableBits - 1;
+        static constexpr size_t tableSize = size_t(1) << tableBits, bucketCount = size_t(1) << bucketBits;
+        static constexpr uint32_t emptySlot = uint32_t(-1);
+        static constexpr unsigned int maxSeeds = 64;
+
+        uint64_t seed = 0;
+        uint32_t displacement[bucketCount] = {};
+        uint64_t keys[tableSize] = {};
+        uint32_t values[tableSize] = {};
+
+        /**
+         * The splitmix64 finalizer, the bucket is selected by the high bits and the slot by the low ones.
+         */
+        static constexpr inline uint64_t mix(uint64_t k, uint64_t seed)
+        {
+            uint64_t z = k + seed * 0x9e3779b97f4a7c15ull;
+            z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+            z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+            return z ^ (z >> 31);
+        }
+
+        static constexpr inline size_t bucketOf(uint64_t z) {
+            return (z >> 40) & (bucketCount - 1);
+        }
+
+        constexpr inline bool build(const uint64_t (&k)[n], const uint32_t (&v)[n])
+        {
+            uint32_t index[tableSize] = {};
+
+            for(size_t i = 0; i < tableSize; i++)
+                index[i] = emptySlot;
+
+            // Counting sort of the keys by bucket.
+            size_t start[bucketCount + 1] = {}, order[n] = {}, fill[bucketCount] = {};
+            size_t largest = 0;
+
+            for(size_t i = 0; i < n; i++)
+                start[bucketOf(mix(k[i], seed)) + 1]++;
+
+            for(size_t b = 0; b < bucketCount; b++)
+            {
+                if(largest < start[b + 1])
+                    largest = start[b + 1];
+
+                start[b + 1] += start[b];
+            }
+
+            for(size_t i = 0; i < n; i++)
+            {
+                const auto b = bucketOf(mix(k[i], seed));
+                order[start[b] + fill[b]++] = i;
+            }
+
+            for(size_t size = largest; size; size--)
+            {
+                for(size_t b = 0; b < bucketCount; b++)
+                {
+                    if(start[b + 1] - start[b] != size)
+                        continue;
+
+                    bool placed = false;
+
+                    for(uint32_t d = 0; !placed && d < tableSize; d++)
+                    {
+                        size_t done = 0;
+
+                        for(; done < size; done++)
+                        {
+                            const auto i = order[start[b] + done];
+                            const auto s = (mix(k[i], seed) ^ d) & (tableSize - 1);
+
+                            if(index[s] != emptySlot)
+                                break;
+
+                            index[s] = uint32_t(i);
+                        }
+
+                        if(done == size)
+                        {
+                            displacement[b] = d;
+                            placed = true;
+                        }
+
+                        // Undo the partial placement.
+                        while(!placed && done--)
+                            index[(mix(k[order[start[b] + done]], seed) ^ d) & (tableSize - 1)] = emptySlot;
+                    }
+
+                    if(!placed)
+                        return false;
+                }
+            }
+
+            for(size_t s = 0; s < tableSize; s++)
+            {
+                keys[s] = (index[s] != emptySlot) ? k[index[s]] : 0;
+                values[s] = (index[s] != emptySlot) ? v[index[s]] : emptySlot;
+            }
+
+            return true;
+        }
+
+    public:
+        /**
+         * Set if the table could be built (i.e. the keys are unique).
+         */
+        bool ok = false;
+
+        constexpr inline PerfectHash(const uint64_t (&k)[n], const uint32_t (&v)[n])
+        {
+            for(; seed < maxSeeds; seed++)
+                if((ok = build(k, v)))
+                    break;
+        }
+
+        /**
+         * Find the value associated with a key.
+         */
+        constexpr inline bool find(uint64_t k, uint32_t &v) const
+        {
+            const auto z = mix(k, seed);
+            const auto s = (z ^ displacement[bucketOf(z)]) & (tableSize - 1);
+            v = values[s];
+            return (keys[s] == k) & (values[s] != emptySlot);
+        }
+    };
+
+    template<>
+    class PerfectHash<0>
+    {
+    public:
+        bool ok = true;
+
+        constexpr inline bool find(uint64_t, uint32_t &) const {
+            return false;
+        }
+    };
+}
+
+}
+
+#endif /* _RPCPERFECTHASH_H_ */
@@ -37,11 +37,7 @@ template<class T, size_t n> struct TypeInfo<T[n]>: CollectionTypeBase<remove_con
 		if(!VarUint4::write(s, n))
 			return false;
 
-		for(const auto &x: v)
-			if(!TypeInfo<T>::write(s, x))
-				return false;
-
-		return true;
+		return detail::writeElements(s, v, n);
 	}
 
 	template<class S, class A> static inline bool read(S& s, T(&v)[n], A&& a)
@@ -53,13 +49,7 @@ template<class T, size_t n> struct TypeInfo<T[n]>: CollectionTypeBase<remove_con
 		if(count != n)
 			return false;
 
-		for(auto& x: v)
-		{
-			if(!TypeInfo<T>::read(s, x))
-				return false;
-		}
-
-		return true;
+		return detail::readElements(s, v, n);
 	}
 };
 
@@ -70,10 +70,25 @@ namespace detail
 		}
 	};
 	
+	/**
+	 * Checks if the TypeInfo of an argument type provides a way to create the object to be deserialized into.
+	 */
+	template<class T, class S, class = void> struct has_make: false_type {};
+	template<class T, class S> struct has_make<T, S, decltype(void(TypeInfo<T>::make(declval<S&>())))>: true_type {};
+
+	template<class T, class S>
+	static inline T makeArgument(S& s)
+	{
+		if constexpr(has_make<T, S>::value)
+			return TypeInfo<T>::make(s);
+		else
+			return T();
+	}
+
 	template<class T, class S>
 	static inline T readNext(S& s, bool &ok) 
 	{
-		T v;
+		T v = makeArgument<T>(s);
 
 		if(ok)
 		{
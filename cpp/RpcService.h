@@ -91,6 +91,7 @@ protected:
 public:
     using Endpoint::call;
     using Endpoint::install;
+    using Endpoint::installOnce;
     using Endpoint::uninstall;
     using Endpoint::lookup;
     using Endpoint::provide;
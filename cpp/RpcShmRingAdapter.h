@@ -0,0 +1,487 @@
+#ifndef _RPCSHMRINGADAPTER_H_
+#define _RPCSHMRINGADAPTER_H_
+
+#include "RpcFail.h"
+#include "RpcFdStreamAdapter.h"
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+
+#include <cassert>
+#include <cstring>
+
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+namespace rpc {
+
+namespace detail
+{
+    /**
+     * Control block of a single-producer/single-consumer byte ring in shared memory.
+     *
+     * The producer and consumer owned fields are placed on separate cache lines. The positions
+     * are monotonically increasing byte counters, the index into the ring is obtained by masking.
+     */
+    struct ShmRingControl
+    {
+        static_assert(std::atomic<uint64_t>::is_always_lock_free);
+        static_assert(std::atomic<uint32_t>::is_always_lock_free);
+
+        /// Written by the producer.
+        alignas(64) std::atomic<uint64_t> head;
+        std::atomic<uint32_t> headSignal;
+        std::atomic<uint32_t> producerWaiting;
+
+        /// Written by the consumer.
+        alignas(64) std::atomic<uint64_t> tail;
+        std::atomic<uint32_t> tailSignal;
+        std::atomic<uint32_t> consumerWaiting;
+
+        /// Written by either end when the connection is closed.
+        alignas(64) std::atomic<uint32_t> closed;
+    };
+
+    /**
+     * Header of the shared memory region holding the two rings.
+     */
+    struct alignas(64) ShmRingRegionHeader
+    {
+        static constexpr uint32_t expectedMagic = 0x524f4c4c;
+
+        uint32_t magic;
+        uint32_t capacity;
+    };
+}
+
+/**
+ * Message transport adapter using a pair of lock-free single-producer/single-consumer
+ * rings in shared memory, one for each direction.
+ *
+ * Messages are serialized directly into the outbound ring and handed to the receiving
+ * endpoint via an accessor pointing into the inbound ring, so there is no copying or
+ * dynamic memory allocation for transferring a message. Waiting for data (or space) is
+ * done by spinning for an adaptively adjusted amount of time, then falling back to
+ * sleeping on a futex in the shared memory.
+ *
+ * The rings use their own record framing: a four byte little-endian length field precedes
+ * the payload, records are aligned to four byte boundaries and a length field with all bits
+ * set marks the end of the usable space before wrapping around.
+ *
+ * NOTE: the maximal size of a message is about half of the ring capacity.
+ */
+class ShmRingAdapter
+{
+    using Control = detail::ShmRingControl;
+    using Header = detail::ShmRingRegionHeader;
+
+    static constexpr uint32_t wrapMarker = 0xffffffff;
+    static constexpr unsigned int minSpin = 16, maxSpin = 16 * 1024;
+
+    struct Ring
+    {
+        Control* control = nullptr;
+        char* data = nullptr;
+        size_t capacity = 0;
+        unsigned int spinLimit = minSpin;
+    };
+
+    void* region = MAP_FAILED;
+    size_t regionSize = 0;
+    Ring tx, rx;
+    std::mutex txLock;
+
+    static inline constexpr size_t align(size_t s) {
+        return (s + 3) & ~(size_t)3;
+    }
+
+    static inline constexpr size_t recordSize(size_t payload) {
+        return align(sizeof(uint32_t) + payload);
+    }
+
+    static inline size_t regionSizeFor(size_t capacity) {
+        return sizeof(Header) + 2 * (sizeof(Control) + capacity);
+    }
+
+    /**
+     * The capacity must be a power of two (for masking the positions), large enough to keep the
+     * control block of the second ring aligned.
+     */
+    static inline constexpr bool isValidCapacity(size_t capacity) {
+        return alignof(Control) <= capacity && !(capacity & (capacity - 1)) && capacity <= UINT32_MAX;
+    }
+
+    static inline void relax()
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+        asm volatile("yield");
+#endif
+    }
+
+    static inline void futexWait(std::atomic<uint32_t> &word, uint32_t expected) {
+        syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAIT, expected, nullptr, nullptr, 0);
+    }
+
+    static inline void futexWake(std::atomic<uint32_t> &word) {
+        syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAKE, 1, nullptr, nullptr, 0);
+    }
+
+    /**
+     * Notify the other end about a change, if it is waiting for it.
+     *
+     * NOTE: the change must be stored with sequentially consistent ordering, like the flag is
+     *       loaded here, see _wait_.
+     */
+    static inline void signal(std::atomic<uint32_t> &word, std::atomic<uint32_t> &waiting)
+    {
+        if(waiting.load())
+        {
+            word.fetch_add(1);
+            futexWake(word);
+        }
+    }
+
+    /**
+     * Wait until the condition becomes true or the ring gets closed.
+     *
+     * Spins first, then goes to sleep on the futex word that is bumped by the other end. The
+     * spinning time is increased if it was enough to wait for the condition and decreased if not.
+     *
+     * NOTE: the condition must load the shared state with sequentially consistent ordering. Then
+     *       either the other end sees the flag set here or this sees the change made before the
+     *       flag is checked in _signal_. With weaker ordering both loads could be performed before
+     *       the corresponding stores are visible, and the wakeup would be lost.
+     */
+    template<class Cond>
+    static inline void wait(Ring& r, std::atomic<uint32_t> &word, std::atomic<uint32_t> &waiting, Cond&& cond)
+    {
+        auto ready = [&](){ return cond() || r.control->closed.load(std::memory_order_acquire); };
+
+        for(auto i = 0u; i < r.spinLimit; i++)
+        {
+            if(ready())
+            {
+                if(r.spinLimit < maxSpin)
+                    r.spinLimit *= 2;
+
+                return;
+            }
+
+            relax();
+        }
+
+        if(minSpin < r.spinLimit)
+            r.spinLimit /= 2;
+
+        while(!ready())
+        {
+            const auto seq = word.load();
+            waiting.store(1);
+
+            if(!ready())
+                futexWait(word, seq);
+
+            waiting.store(0);
+        }
+    }
+
+    static inline void close(Ring &r)
+    {
+        r.control->closed.store(1);
+        r.control->headSignal.fetch_add(1);
+        r.control->tailSignal.fetch_add(1);
+        futexWake(r.control->headSignal);
+        futexWake(r.control->tailSignal);
+    }
+
+    inline void setup(Ring &r, char* base, size_t capacity)
+    {
+        r.control = reinterpret_cast<Control*>(base);
+        r.data = base + sizeof(Control);
+        r.capacity = capacity;
+    }
+
+public:
+    using InputAccessor = PreallocatedMemoryBufferStream::CheckedAccessor;
+
+    /**
+     * Inbound message, pointing directly into the ring.
+     *
+     * Valid only during the invocation of the receive callback.
+     */
+    class Message
+    {
+        friend ShmRingAdapter;
+        char *start, *end;
+
+        inline Message(char* start, char* end): start(start), end(end) {}
+
+    public:
+        inline auto access() {
+            return InputAccessor(start, end);
+        }
+    };
+
+    /**
+     * Outbound message being serialized directly into the ring.
+     *
+     * Holds the transmit lock of the adapter until it is sent or destroyed, the
+     * message is published to the receiver only if it is sent.
+     *
+     * If the message could not be placed in the ring (because it is too large or the
+     * connection is closed) it is serialized into a scratch buffer and sending it fails.
+     */
+    class Writer: public PreallocatedMemoryBufferStream::Accessor
+    {
+        friend ShmRingAdapter;
+        std::unique_lock<std::mutex> lock;
+        std::unique_ptr<char[]> scratch;
+        uint64_t next = 0;
+        bool valid = false;
+
+        inline Writer(std::mutex &m): lock(m) {}
+    };
+
+    struct MessageFactory
+    {
+        ShmRingAdapter* adapter;
+
+        inline auto build(size_t s) {
+            return adapter->reserve(s);
+        }
+
+        static inline auto done(Writer &&w) {
+            return rpc::move(w);
+        }
+    };
+
+    /**
+     * Create an anonymous shared memory region, suitable for connecting two adapters, with
+     * the specified ring capacity (a power of two) for each direction.
+     *
+     * The resulting file descriptor can be shared with another process via fork or by
+     * passing it over a unix domain socket. It has the close-on-exec flag set.
+     *
+     * Returns the file descriptor or -1 on error.
+     */
+    static inline int createRegion(size_t capacity = 1024 * 1024)
+    {
+        assert(isValidCapacity(capacity));
+
+        const auto fd = memfd_create("rpc-shm-ring", MFD_CLOEXEC);
+
+        if(fd < 0)
+            return -1;
+
+        const auto size = regionSizeFor(capacity);
+
+        if(ftruncate(fd, size) == 0)
+        {
+            if(auto p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0); p != MAP_FAILED)
+            {
+                // The rest of the region is zero initialized by ftruncate.
+                auto h = static_cast<Header*>(p);
+                h->capacity = (uint32_t)capacity;
+                h->magic = Header::expectedMagic;
+                munmap(p, size);
+                return fd;
+            }
+        }
+
+        ::close(fd);
+        return -1;
+    }
+
+    ShmRingAdapter(const ShmRingAdapter&) = delete;
+
+    /**
+     * Map the shared memory region created by createRegion.
+     *
+     * The two ends of the connection must use different values for the _initiator_ argument,
+     * it determines which ring is used in which direction. The file descriptor is not needed
+     * after construction.
+     */
+    inline ShmRingAdapter(int fd, bool initiator)
+    {
+        Header h;
+        struct stat st;
+
+        // The header is writable by the other end, so it is not trusted to describe a valid layout.
+        if(pread(fd, &h, sizeof(h), 0) != sizeof(h) || h.magic != Header::expectedMagic || !isValidCapacity(h.capacity)
+        || fstat(fd, &st) != 0 || st.st_size < 0 || (size_t)st.st_size < regionSizeFor(h.capacity))
+        {
+            fail("invalid shared memory ring region");
+            return;
+        }
+
+        regionSize = regionSizeFor(h.capacity);
+        region = mmap(nullptr, regionSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+        if(region == MAP_FAILED)
+        {
+            fail("could not map shared memory ring region");
+            return;
+        }
+
+        auto first = static_cast<char*>(region) + sizeof(Header);
+        auto second = first + sizeof(Control) + h.capacity;
+        setup(initiator ? tx : rx, first, h.capacity);
+        setup(initiator ? rx : tx, second, h.capacity);
+    }
+
+    /**
+     * Closes the connection and unmaps the shared memory.
+     */
+    inline ~ShmRingAdapter()
+    {
+        if(region != MAP_FAILED)
+        {
+            shutdown();
+            munmap(region, regionSize);
+        }
+    }
+
+    /**
+     * Close both directions, wakes up the other end if it is waiting.
+     *
+     * Messages already in the rings can still be received by the other end.
+     */
+    inline void shutdown()
+    {
+        close(tx);
+        close(rx);
+    }
+
+    inline auto messageFactory() {
+        return MessageFactory{this};
+    }
+
+    /**
+     * Allocate space for a message in the outbound ring (waiting for it if needed).
+     */
+    inline Writer reserve(size_t length)
+    {
+        Writer w(txLock);
+
+        const auto size = recordSize(length);
+
+        if(size <= tx.capacity / 2)
+        {
+            auto pos = tx.control->head.load(std::memory_order_relaxed);
+            const auto idx = pos & (tx.capacity - 1);
+            const auto contiguous = tx.capacity - idx;
+            const auto padding = (contiguous < size) ? contiguous : 0;
+
+            wait(tx, tx.control->tailSignal, tx.control->producerWaiting, [&](){
+                return padding + size <= tx.capacity - (pos - tx.control->tail.load(std::memory_order_seq_cst));
+            });
+
+            if(!tx.control->closed.load(std::memory_order_acquire))
+            {
+                if(padding)
+                {
+                    memcpy(tx.data + idx, &wrapMarker, sizeof(wrapMarker));
+                    pos += padding;
+                }
+
+                auto record = tx.data + (pos & (tx.capacity - 1));
+                const uint32_t l = (uint32_t)length;
+                memcpy(record, &l, sizeof(l));
+
+                w.ptr = record + sizeof(l);
+                w.end = w.ptr + length;
+                w.next = pos + size;
+                w.valid = true;
+                return w;
+            }
+        }
+
+        w.scratch.reset(new char[length]);
+        w.ptr = w.scratch.get();
+        w.end = w.ptr + length;
+        return w;
+    }
+
+    /**
+     * Publish a message to the receiver.
+     *
+     * Returns false if the message could not be placed in the ring.
+     */
+    inline bool send(Writer&& w)
+    {
+        auto lock = rpc::move(w.lock);
+
+        if(!w.valid)
+            return false;
+
+        tx.control->head.store(w.next);
+        signal(tx.control->headSignal, tx.control->consumerWaiting);
+        return true;
+    }
+
+    /**
+     * Receive messages and pass them to the callback one by one.
+     *
+     * Blocks until at least one message is available then dispatches all the available ones,
+     * the space occupied by each is released to the sender after the callback returns.
+     *
+     * Returns false if the connection is closed and there are no more messages, the ring
+     * contents are corrupted or if the callback returns false.
+     */
+    template<class C>
+    bool receive(C&& cb)
+    {
+        auto tail = rx.control->tail.load(std::memory_order_relaxed);
+
+        wait(rx, rx.control->headSignal, rx.control->consumerWaiting, [&](){
+            return rx.control->head.load(std::memory_order_seq_cst) != tail;
+        });
+
+        const auto head = rx.control->head.load(std::memory_order_acquire);
+
+        if(head == tail)
+            return false;
+
+        while(tail != head)
+        {
+            const auto idx = tail & (rx.capacity - 1);
+            auto record = rx.data + idx;
+
+            uint32_t length;
+            memcpy(&length, record, sizeof(length));
+
+            if(length == wrapMarker)
+            {
+                tail += rx.capacity - idx;
+                continue;
+            }
+
+            const auto size = recordSize(length);
+
+            if(rx.capacity - idx < size || head - tail < size)
+                return false;
+
+            auto payload = record + sizeof(length);
+            const bool ok = cb(Message(payload, payload + length));
+
+            tail += size;
+            rx.control->tail.store(tail);
+            signal(rx.control->tailSignal, rx.control->producerWaiting);
+
+            if(!ok)
+                return false;
+        }
+
+        return true;
+    }
+};
+
+}
+
+#endif /* _RPCSHMRINGADAPTER_H_ */
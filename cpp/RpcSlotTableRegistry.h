@@ -0,0 +1,709 @@
+#ifndef _RPCSLOTTABLEREGISTRY_H_
+#define _RPCSLOTTABLEREGISTRY_H_
+
+#include <new>
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <unordered_map>
+#include <type_traits>
+
+#include <cstddef>
+#include <cstdint>
+
+namespace rpc {
+
+namespace detail
+{
+    /**
+     * Registry for small, densely allocated integer keys (like call ids), stored in a table indexed by the key.
+     *
+     * The lowest bit of a key marks one-shot entries (see below), the bits above it are the generation
+     * of the slot, that is incremented each time an entry is removed from it, and the rest of the bits
+     * select the slot. Keys allocated by _insert_ reuse the slots freed earlier, but not the keys
+     * themselves (until the generation wraps around), so a stale key - for example one in a message
+     * that was sent before the entry was removed - is not found.
+     * As the slot is in the high bits, the keys - that are variable length encoded on the wire - stay
+     * as short as the number of slots in use allows, regardless of how many times they were reused.
+     *
+     * Lookups do not lock, they never contend with modifications - that are serialized using a mutex.
+     * When the table is grown the old one is retained until the registry is destroyed, so that a
+     * concurrent lookup can finish on it (this at most doubles the memory used by the tables).
+     *
+     * Lookups are done in read sections (see _enter_ and _leave_), the value found can be used until
+     * the end of the section, even if the entry is removed in the meantime. Removed values are retired
+     * with the current epoch, and they are destroyed only after the epoch has been advanced twice,
+     * that is possible only when no read section is left that started before the removal. Modifications
+     * never wait for the readers, they advance the epoch only if it is possible right away, so a value
+     * removed by a method while it is being invoked is simply destroyed later. The storage of destroyed
+     * values is kept for reuse, so installing and removing methods repeatedly - like reply callbacks -
+     * does not allocate in steady state.
+     *
+     * Explicitly specified keys (see _add_) that can not be stored in the table - because they have
+     * the one-shot bit set, their index is far beyond the end of the table or the slot is taken by an other
+     * generation - are kept in a hash map. Lookups fall back to it (under the lock) only if such entries
+     * exist and the table has no match.
+     *
+     * One-shot entries (like reply callbacks, see Core::addOnce) are kept in a separate ring of slots,
+     * their keys have the same layout with the lowest bit set, so the key of a slot of the ring is about
+     * as long on the wire as its index. They are allocated and consumed using atomic operations only,
+     * without the mutex, so request/response throughput does not depend on the churn of the registry.
+     * The ring is grown - by adding blocks of doubling size - only if a free slot could not be found
+     * quickly.
+     *
+     * NOTE: a read section must not be left open while waiting for an other thread (that would only
+     *       delay the destruction of removed values though).
+     */
+    template<class K, class V>
+    class SlotTableRegistry
+    {
+        static_assert(std::is_unsigned_v<K> && sizeof(K) == sizeof(uint32_t), "slot table keys must be 32 bit unsigned integers");
+
+        static constexpr unsigned int generationBits = 4, indexShift = generationBits + 1;
+        static constexpr K generationMask = (K(1) << generationBits) - 1, onceTag = 1;
+        static constexpr K empty = K(-1), maxIndex = K(-1) >> indexShift;
+        static constexpr size_t initialSize = 16;
+
+        /**
+         * Explicitly specified keys do not make the table grow to more than twice its size (or this).
+         */
+        static constexpr size_t explicitGrowthLimit = 1024;
+
+        static constexpr size_t onceFirstBlock = 64;
+        static constexpr unsigned int onceMaxBlocks = 17, onceProbes = 16;
+
+        /**
+         * The state of a one-shot slot is its generation and one of these.
+         */
+        static constexpr K onceFree = 0, onceBusy = 1, onceReady = 2, onceStateMask = 3;
+
+        static constexpr K key(K idx, K gen) {
+            return (idx << indexShift) | (gen << 1);
+        }
+
+        static constexpr K indexOf(K k) {
+            return k >> indexShift;
+        }
+
+        static constexpr K generationOf(K k) {
+            return (k >> 1) & generationMask;
+        }
+
+        struct Slot
+        {
+            std::atomic<K> key{empty};
+            std::atomic<V*> value{nullptr};
+        };
+
+        struct Table
+        {
+            size_t size;
+            std::unique_ptr<Slot[]> slots;
+
+            inline Table(size_t size): size(size), slots(new Slot[size]) {}
+        };
+
+        struct OnceSlot
+        {
+            std::atomic<K> state{onceFree};
+            alignas(V) unsigned char storage[sizeof(V)];
+
+            inline V* value() {
+                return std::launder(reinterpret_cast<V*>(storage));
+            }
+        };
+
+        std::atomic<OnceSlot*> onceBlocks[onceMaxBlocks] = {};
+        std::atomic<size_t> onceCount{0}, onceCursor{0}, onceRecent{0};
+
+        /**
+         * Offset of the indices in the one-shot keys relative to the slots of the ring (see _reserveKeys_).
+         */
+        K onceBase = 0;
+
+        std::atomic<Table*> current{nullptr};
+        std::vector<std::unique_ptr<Table>> tables;
+        std::vector<K> generation, freeIndices;
+        std::vector<V*> spare;
+        std::allocator<V> alloc;
+        K next = 0;
+        std::mutex mut;
+
+        /**
+         * Read sections are counted by the parity of the epoch they have started in.
+         */
+        std::atomic<unsigned int> epoch{0};
+        std::atomic<size_t> readers[2] = {};
+        std::vector<std::pair<V*, unsigned int>> retired;
+
+        std::unordered_map<K, V*> overflow;
+        std::atomic<size_t> overflowCount{0};
+
+        /**
+         * Get storage for a new value.
+         *
+         * NOTE: must be called with the lock held.
+         */
+        inline V* make(V&& v)
+        {
+            V* p;
+
+            if(spare.empty())
+            {
+                p = alloc.allocate(1);
+            }
+            else
+            {
+                p = spare.back();
+                spare.pop_back();
+            }
+
+            return new(p) V(std::move(v));
+        }
+
+        /**
+         * Destroy a removed value once no reader can have found it.
+         *
+         * NOTE: must be called with the lock held.
+         */
+        inline void retire(V* v)
+        {
+            retired.emplace_back(v, epoch.load(std::memory_order_relaxed));
+            reclaim();
+        }
+
+        /**
+         * Advance the epoch as far as the active read sections allow it, and destroy
+         * the values retired at least two epochs earlier.
+         *
+         * A value retired in epoch _e_ may have been found by read sections started in
+         * epoch _e_ or earlier. Advancing to _e + 1_ requires the sections started in _e - 1_
+         * to be finished, and advancing to _e + 2_ requires the ones started in _e_ as well.
+         *
+         * NOTE: must be called with the lock held.
+         */
+        inline void reclaim()
+        {
+            if(retired.empty())
+                return;
+
+            auto e = epoch.load(std::memory_order_relaxed);
+
+            for(auto i = 0u; i < 2 && readers[(e + 1) & 1].load() == 0; i++)
+                epoch.store(++e);
+
+            size_t n = 0;
+
+            for(auto &r: retired)
+            {
+                if(2 <= e - r.second)
+                {
+                    r.first->~V();
+                    spare.push_back(r.first);
+                }
+                else
+                {
+                    retired[n++] = r;
+                }
+            }
+
+            retired.resize(n);
+        }
+
+        inline bool isOverflow(K k)
+        {
+            std::lock_guard _(mut);
+            return overflow.count(k) != 0;
+        }
+
+        /**
+         * Find the first generation for the slot that does not collide with an overflow key.
+         *
+         * NOTE: must be called with the lock held.
+         */
+        inline K freeKey(K idx)
+        {
+            for(auto i = 0u; i <= generationMask; i++)
+            {
+                const auto k = key(idx, generation[idx]);
+
+                if(!overflow.count(k))
+                    return k;
+
+                generation[idx] = (generation[idx] + 1) & generationMask;
+            }
+
+            return empty;
+        }
+
+        /**
+         * Make sure that the current table has a slot with the given index.
+         *
+         * NOTE: must be called with the lock held.
+         */
+        inline void reserve(K idx)
+        {
+            auto t = current.load(std::memory_order_relaxed);
+            const size_t size = t ? t->size : 0;
+
+            if(idx < size)
+                return;
+
+            auto newSize = size ? 2 * size : initialSize;
+
+            while(newSize <= idx)
+                newSize *= 2;
+
+            std::unique_ptr<Table> n(new Table(newSize));
+
+            for(size_t i = 0; i < size; i++)
+            {
+                n->slots[i].value.store(t->slots[i].value.load(std::memory_order_relaxed), std::memory_order_relaxed);
+                n->slots[i].key.store(t->slots[i].key.load(std::memory_order_relaxed), std::memory_order_relaxed);
+            }
+
+            generation.resize(newSize, 0);
+            current.store(n.get(), std::memory_order_release);
+            tables.push_back(std::move(n));
+        }
+
+        /**
+         * Store a new value in a slot that is known to be free.
+         *
+         * NOTE: must be called with the lock held.
+         */
+        inline void store(K idx, K k, V&& v)
+        {
+            auto &s = current.load(std::memory_order_relaxed)->slots[idx];
+            s.value.store(make(std::move(v)), std::memory_order_release);
+            s.key.store(k, std::memory_order_release);
+            generation[idx] = generationOf(k);
+        }
+
+        /**
+         * Get a one-shot slot by its index within the ring (must be less than _onceCount_).
+         */
+        inline OnceSlot& onceSlot(size_t r)
+        {
+            const auto b = 63u - __builtin_clzll(r / onceFirstBlock + 1);
+            return onceBlocks[b].load(std::memory_order_acquire)[r - onceFirstBlock * ((size_t(1) << b) - 1)];
+        }
+
+        /**
+         * Add the next block to the ring of one-shot slots.
+         *
+         * NOTE: must be called with the lock held.
+         */
+        inline bool growOnce()
+        {
+            const auto n = onceCount.load(std::memory_order_relaxed);
+            const auto b = 63u - __builtin_clzll(n / onceFirstBlock + 1);
+
+            if(onceMaxBlocks <= b)
+                return false;
+
+            onceBlocks[b].store(new OnceSlot[onceFirstBlock << b], std::memory_order_release);
+            onceCount.store(n + (onceFirstBlock << b), std::memory_order_release);
+            return true;
+        }
+
+        /**
+         * Check if a one-shot key is in use (it may be claimed already, but not yet released).
+         */
+        inline bool isOnceTaken(K k)
+        {
+            const size_t r = indexOf(k) - onceBase;
+
+            if(onceCount.load(std::memory_order_acquire) <= r)
+                return false;
+
+            const auto st = onceSlot(r).state.load();
+            return (st >> 2) == generationOf(k) && (st & onceStateMask) != onceFree;
+        }
+
+        /**
+         * Check if the table could be grown to have a slot with the given index for an explicit key.
+         */
+        inline bool isNear(K idx)
+        {
+            auto t = current.load(std::memory_order_relaxed);
+            return idx <= maxIndex && idx < std::max(2 * (t ? t->size : 0), explicitGrowthLimit);
+        }
+
+        inline bool isFree(K idx)
+        {
+            auto t = current.load(std::memory_order_relaxed);
+            return !t || t->size <= idx || t->slots[idx].key.load(std::memory_order_relaxed) == empty;
+        }
+
+    public:
+        inline SlotTableRegistry() = default;
+        SlotTableRegistry(const SlotTableRegistry&) = delete;
+
+        inline ~SlotTableRegistry()
+        {
+            if(auto t = current.load(std::memory_order_relaxed))
+            {
+                for(size_t i = 0; i < t->size; i++)
+                {
+                    if(auto v = t->slots[i].value.load(std::memory_order_relaxed))
+                    {
+                        v->~V();
+                        alloc.deallocate(v, 1);
+                    }
+                }
+            }
+
+            for(auto &r: overflow)
+            {
+                r.second->~V();
+                alloc.deallocate(r.second, 1);
+            }
+
+            for(auto &r: retired)
+            {
+                r.first->~V();
+                alloc.deallocate(r.first, 1);
+            }
+
+            for(auto v: spare)
+                alloc.deallocate(v, 1);
+
+            for(auto b = 0u; b < onceMaxBlocks; b++)
+            {
+                if(auto slots = onceBlocks[b].load(std::memory_order_relaxed))
+                {
+                    for(size_t i = 0; i < (onceFirstBlock << b); i++)
+                        if((slots[i].state.load(std::memory_order_relaxed) & onceStateMask) == onceReady)
+                            slots[i].value()->~V();
+
+                    delete[] slots;
+                }
+            }
+        }
+
+        /**
+         * Remove an entry, one-shot entries can be removed (cancelled) until they are claimed.
+         */
+        inline bool remove(const K& k)
+        {
+            if(isOnce(k) && claimOnce(k))
+            {
+                releaseOnce(k);
+                return true;
+            }
+
+            std::lock_guard _(mut);
+
+            const auto idx = indexOf(k);
+            auto t = current.load(std::memory_order_relaxed);
+
+            if(!t || t->size <= idx || t->slots[idx].key.load(std::memory_order_relaxed) != k)
+            {
+                auto it = overflow.find(k);
+
+                if(it == overflow.end())
+                    return false;
+
+                auto v = it->second;
+                overflow.erase(it);
+                overflowCount.store(overflow.size(), std::memory_order_relaxed);
+                retire(v);
+                return true;
+            }
+
+            auto v = t->slots[idx].value.load(std::memory_order_relaxed);
+
+            // Lookups may still be running on retired tables, so the entry is cleared from them as well.
+            for(auto &r: tables)
+            {
+                if(idx < r->size)
+                {
+                    r->slots[idx].key.store(empty, std::memory_order_relaxed);
+                    r->slots[idx].value.store(nullptr, std::memory_order_release);
+                }
+            }
+
+            generation[idx] = (generation[idx] + 1) & generationMask;
+            freeIndices.push_back(idx);
+
+            retire(v);
+            return true;
+        }
+
+        /**
+         * Add a value with an explicitly specified key.
+         *
+         * Any key can be used, the ones that can not be stored in the table are kept in the
+         * overflow map (see above). Returns false if the key is already taken.
+         */
+        inline bool add(const K& k, V&& v)
+        {
+            std::lock_guard _(mut);
+            reclaim();
+
+            const auto idx = indexOf(k);
+
+            if(overflow.count(k))
+                return false;
+
+            if(isOnce(k) || !isNear(idx) || !isFree(idx))
+            {
+                if(!isOnce(k) && isNear(idx) && current.load(std::memory_order_relaxed)->slots[idx].key.load(std::memory_order_relaxed) == k)
+                    return false;
+
+                auto p = make(std::move(v));
+                overflow.emplace(k, p);
+                overflowCount.store(overflow.size());
+
+                // A one-shot entry may be added with the same key concurrently, the one that comes later backs off (see insertOnce).
+                if(isOnce(k) && isOnceTaken(k))
+                {
+                    overflow.erase(k);
+                    overflowCount.store(overflow.size(), std::memory_order_relaxed);
+                    p->~V();
+                    spare.push_back(p);
+                    return false;
+                }
+
+                return true;
+            }
+
+            reserve(idx);
+
+            for(; next < idx; next++)
+                if(isFree(next))
+                    freeIndices.push_back(next);
+
+            if(next == idx)
+                next++;
+
+            store(idx, k, std::move(v));
+            return true;
+        }
+
+        /**
+         * Make _insert_ and _insertOnce_ allocate only keys not less than _count_ (the ones below may
+         * still be used by _add_).
+         *
+         * NOTE: must be called before adding any one-shot entries.
+         */
+        inline void reserveKeys(K count)
+        {
+            std::lock_guard _(mut);
+
+            // The first index all the keys of which are at least _count_.
+            const auto idx = indexOf(count + (K(1) << indexShift) - 1);
+
+            if(next < idx && idx <= maxIndex)
+                next = idx;
+
+            if(onceBase < idx && idx <= maxIndex)
+                onceBase = idx;
+        }
+
+        /**
+         * Add a value with a key allocated by the registry.
+         *
+         * Returns the key or all ones if there is no free slot left.
+         */
+        inline K insert(V&& v)
+        {
+            std::lock_guard _(mut);
+            reclaim();
+
+            while(true)
+            {
+                K idx;
+
+                if(!freeIndices.empty())
+                {
+                    idx = freeIndices.back();
+                    freeIndices.pop_back();
+                }
+                else if(next <= maxIndex)
+                {
+                    idx = next++;
+                }
+                else
+                {
+                    return empty;
+                }
+
+                if(!isFree(idx))
+                    continue;
+
+                reserve(idx);
+
+                if(const auto k = freeKey(idx); k != empty)
+                {
+                    store(idx, k, std::move(v));
+                    return k;
+                }
+            }
+        }
+
+        /**
+         * Start a read section, returns the token to be passed to _leave_.
+         *
+         * The counter is incremented speculatively, if the epoch has been advanced in the
+         * meantime the modifier may have missed it, so it is retried with the new epoch.
+         */
+        inline unsigned int enter()
+        {
+            while(true)
+            {
+                const auto e = epoch.load();
+                readers[e & 1].fetch_add(1);
+
+                if(epoch.load() == e)
+                    return e & 1;
+
+                readers[e & 1].fetch_sub(1);
+            }
+        }
+
+        /**
+         * Finish a read section, the values found in it must not be used afterwards.
+         */
+        inline void leave(unsigned int s) {
+            readers[s].fetch_sub(1, std::memory_order_release);
+        }
+
+        /**
+         * Look up a value, must be called in a read section (see _enter_).
+         */
+        inline V* find(const K& k, bool &ok)
+        {
+            const auto idx = indexOf(k);
+
+            if(auto t = current.load(std::memory_order_acquire); t && idx < t->size)
+            {
+                auto &s = t->slots[idx];
+
+                if(s.key.load(std::memory_order_acquire) == k)
+                {
+                    auto v = s.value.load(std::memory_order_acquire);
+
+                    // Recheck in case the slot has been reused in the meantime.
+                    if(v && s.key.load(std::memory_order_relaxed) == k)
+                    {
+                        ok = true;
+                        return v;
+                    }
+                }
+            }
+
+            if(overflowCount.load(std::memory_order_acquire))
+            {
+                std::lock_guard _(mut);
+
+                if(auto it = overflow.find(k); it != overflow.end())
+                {
+                    ok = true;
+                    return it->second;
+                }
+            }
+
+            ok = false;
+            return nullptr;
+        }
+
+        /**
+         * Check if a key belongs to a one-shot entry.
+         */
+        static inline bool isOnce(const K& k) {
+            return (k & onceTag) != 0;
+        }
+
+        /**
+         * Add a one-shot value with a key allocated from the ring.
+         *
+         * Returns the key or all ones if there is no free slot left.
+         */
+        inline K insertOnce(V&& v)
+        {
+            const auto tryInsert = [this, &v](size_t r, K &k)
+            {
+                auto &s = onceSlot(r);
+                auto st = s.state.load(std::memory_order_relaxed);
+
+                if((st & onceStateMask) != onceFree || !s.state.compare_exchange_strong(st, st | onceBusy))
+                    return false;
+
+                k = key(K(r) + onceBase, st >> 2) | onceTag;
+
+                // The same key may have been added explicitly (see add), then this generation is skipped.
+                if(overflowCount.load() && isOverflow(k))
+                {
+                    s.state.store((((st >> 2) + 1) & generationMask) << 2, std::memory_order_release);
+                    return false;
+                }
+
+                new(s.storage) V(std::move(v));
+                s.state.store(st | onceReady, std::memory_order_release);
+                return true;
+            };
+
+            K k;
+
+            // The most recently released slot is tried first, as it is likely to be in the cache.
+            if(onceCount.load(std::memory_order_acquire) && tryInsert(onceRecent.load(std::memory_order_relaxed), k))
+                return k;
+
+            while(true)
+            {
+                const auto n = onceCount.load(std::memory_order_acquire);
+
+                for(auto i = 0u; n && i < onceProbes; i++)
+                    if(tryInsert(onceCursor.fetch_add(1, std::memory_order_relaxed) % n, k))
+                        return k;
+
+                std::lock_guard _(mut);
+
+                if(onceCount.load(std::memory_order_relaxed) == n && !growOnce())
+                    return empty;
+            }
+        }
+
+        /**
+         * Take exclusive ownership of a one-shot entry (that can happen only once).
+         *
+         * Returns nullptr if the key is stale or the entry has already been claimed, otherwise
+         * the value that must be passed back to _releaseOnce_ after use.
+         */
+        inline V* claimOnce(const K& k)
+        {
+            const size_t r = indexOf(k) - onceBase;
+
+            if(!isOnce(k) || onceCount.load(std::memory_order_acquire) <= r)
+                return nullptr;
+
+            auto &s = onceSlot(r);
+            auto st = (generationOf(k) << 2) | onceReady;
+
+            if(!s.state.compare_exchange_strong(st, (st & ~onceStateMask) | onceBusy, std::memory_order_acquire))
+                return nullptr;
+
+            return s.value();
+        }
+
+        /**
+         * Destroy a claimed one-shot entry and free its slot for the next generation.
+         */
+        inline void releaseOnce(const K& k)
+        {
+            const size_t r = indexOf(k) - onceBase;
+            auto &s = onceSlot(r);
+            s.value()->~V();
+            s.state.store(((generationOf(k) + 1) & generationMask) << 2, std::memory_order_release);
+            onceRecent.store(r, std::memory_order_relaxed);
+        }
+    };
+}
+
+}
+
+#endif /* _RPCSLOTTABLEREGISTRY_H_ */
@@ -0,0 +1,143 @@
+#ifndef _RPCSMALLBUFFERPOINTER_H_
+#define _RPCSMALLBUFFERPOINTER_H_
+
+#include <new>
+#include <utility>
+#include <type_traits>
+
+#include <cstddef>
+
+namespace rpc {
+
+namespace detail
+{
+    /**
+     * Owning pointer to a polymorphic object, that stores small objects inline.
+     *
+     * It can be used as the _Pointer_ policy of the Core, so that installing a method whose functor
+     * captures only a few words (like the reply callbacks of the ClientBase) does not need a heap
+     * allocation. Objects that do not fit - or can not be moved without the risk of an exception -
+     * are allocated on the heap.
+     *
+     * Moving the pointer moves the object along with it if it is stored inline.
+     *
+     * NOTE: the heap allocated objects are not taken from the BufferPool, as methods may be
+     *       uninstalled by the destructors of static or thread_local objects (e.g. an endpoint
+     *       owned by one), that can run after the thread cache of the pool is destroyed.
+     */
+    template<class T>
+    class StlSmallBufferPointer
+    {
+        static constexpr size_t inlineSize = 6 * sizeof(void*);
+
+        enum class Op { relocate, destroy };
+
+        /**
+         * Type specific handler of moving and destroying the pointed object.
+         */
+        using Manager = void (*)(Op op, StlSmallBufferPointer &self, StlSmallBufferPointer *dst);
+
+        T* ptr = nullptr;
+        Manager manager = nullptr;
+
+        alignas(std::max_align_t) char storage[inlineSize];
+
+        template<class U>
+        static constexpr bool fitsInline = sizeof(U) <= inlineSize && alignof(U) <= alignof(std::max_align_t)
+            && std::is_nothrow_move_constructible_v<U>;
+
+        template<class U>
+        static void manage(Op op, StlSmallBufferPointer &self, StlSmallBufferPointer *dst)
+        {
+            auto u = static_cast<U*>(self.ptr);
+
+            if constexpr(fitsInline<U>)
+            {
+                if(op == Op::relocate)
+                    dst->ptr = new(dst->storage) U(std::move(*u));
+
+                u->~U();
+            }
+            else if(op == Op::relocate)
+            {
+                dst->ptr = self.ptr;
+            }
+            else
+            {
+                delete u;
+            }
+        }
+
+        inline void reset()
+        {
+            if(ptr)
+            {
+                manager(Op::destroy, *this, nullptr);
+                ptr = nullptr;
+            }
+        }
+
+        inline void take(StlSmallBufferPointer &&o)
+        {
+            if(o.ptr)
+            {
+                o.manager(Op::relocate, o, this);
+                manager = o.manager;
+                o.ptr = nullptr;
+            }
+        }
+
+    public:
+        inline StlSmallBufferPointer() = default;
+        StlSmallBufferPointer(const StlSmallBufferPointer&) = delete;
+        StlSmallBufferPointer& operator=(const StlSmallBufferPointer&) = delete;
+
+        inline StlSmallBufferPointer(StlSmallBufferPointer &&o) {
+            take(std::move(o));
+        }
+
+        inline StlSmallBufferPointer& operator=(StlSmallBufferPointer &&o)
+        {
+            if(this != &o)
+            {
+                reset();
+                take(std::move(o));
+            }
+
+            return *this;
+        }
+
+        inline ~StlSmallBufferPointer() {
+            reset();
+        }
+
+        template<class U, class... Args>
+        static inline StlSmallBufferPointer make(Args&&... args)
+        {
+            static_assert(std::is_base_of_v<T, U>);
+
+            StlSmallBufferPointer ret;
+
+            if constexpr(fitsInline<U>)
+            {
+                ret.ptr = new(ret.storage) U(std::forward<Args>(args)...);
+            }
+            else
+            {
+                ret.ptr = new U(std::forward<Args>(args)...);
+            }
+
+            ret.manager = &manage<U>;
+            return ret;
+        }
+
+        inline T* get() const { return ptr; }
+        inline T* operator->() const { return ptr; }
+        inline T& operator*() const { return *ptr; }
+        inline explicit operator bool() const { return ptr != nullptr; }
+    };
+}
+
+}
+
+#endif /* _RPCSMALLBUFFERPOINTER_H_ */
@@ -0,0 +1,180 @@
+#ifndef _RPCSTATICDISPATCH_H_
+#define _RPCSTATICDISPATCH_H_
+
+#include "RpcCall.h"
+#include "RpcSerdes.h"
+#include "RpcSymbol.h"
+#include "RpcPerfectHash.h"
+
+#include <type_traits>
+
+namespace rpc {
+
+namespace detail
+{
+    /**
+     * Argument types of a statically dispatched method handler (that has the same arguments
+     * as the functors passed to Endpoint::install: endpoint, method handle then the payload).
+     */
+    template<class> struct StaticHandlerSignature;
+
+    template<class Ret, class Ctx1, class Ctx2, class... Args> struct StaticHandlerSignature<Ret (*)(Ctx1, Ctx2, Args...)> {
+        using CallType = Call<remove_cref_t<Args>...>;
+
+        template<class S, class C, class E>
+        static inline const char* invoke(S& s, C&& c, E& e, uint32_t id) {
+            return deserialize<remove_cref_t<Args>...>(s, rpc::forward<C>(c), e, MethodHandle(id));
+        }
+    };
+
+    /**
+     * Checks if an endpoint implementation declares a table of statically dispatched methods.
+     */
+    template<class E, class = void> struct has_static_methods: false_type {};
+    template<class E> struct has_static_methods<E, decltype(void(sizeof(typename E::StaticMethods)))>: true_type {};
+}
+
+/**
+ * Compile-time registration of a method with a fixed identifier (see StaticMethods).
+ *
+ * The _handler_ is a function (or a static member function) that takes the same arguments as the
+ * functors passed to Endpoint::install. If a _symbol_ (a constexpr Symbol object) is specified too,
+ * the method can be looked up by the remote end using it, like the ones registered via _provide_.
+ */
+template<uint32_t methodId, auto handler, const auto&... symbol>
+struct StaticMethod
+{
+    using Signature = detail::StaticHandlerSignature<decltype(handler)>;
+    using CallType = typename Signature::CallType;
+
+    static_assert(sizeof...(symbol) <= 1, "at most one symbol can be associated with a static method");
+    static_assert(((std::is_same_v<typename remove_cref_t<decltype(symbol)>::CallType, CallType>) && ... && true), "static method signature mismatched");
+
+    static constexpr uint32_t id = methodId;
+
+    /**
+     * The identifiers below the ones of the static methods are not allocated dynamically,
+     * so they must be small.
+     */
+    static_assert(id <= 0xffff, "static method identifiers must be small");
+
+    static constexpr bool hasSymbol = sizeof...(symbol) != 0;
+    static constexpr uint64_t symbolHash = (symbol.hash() + ... + uint64_t(0));
+
+    template<class S, class E>
+    static inline const char* invoke(S& s, E& e) {
+        return Signature::invoke(s, handler, e, id);
+    }
+};
+
+/**
+ * Table of methods with identifiers known at compile time.
+ *
+ * An endpoint implementation can declare a table like this as a member type named _StaticMethods_
+ * (e.g. a class derived from StlEndpoint), then the listed methods are dispatched by a sequence
+ * of comparisons against constants - that the compiler turns into a jump table or a binary search
+ * - and their handlers can be inlined. The identifiers that are not listed are looked up in the
+ * dynamic registry of the endpoint as usual, and these are not allocated for dynamic methods.
+ *
+ * Declaring it also makes the built-in lookup method static, so initializing the endpoint does
+ * not allocate any memory. The symbols of the methods are resolved using a perfect hash table
+ * generated at compile time (see PerfectHash), so providing any number of them needs no
+ * registry inserts at startup, and looking one up takes a single probe.
+ */
+template<class... Methods>
+struct StaticMethods
+{
+private:
+    static constexpr uint32_t ids[] = {Methods::id..., 0};
+
+    static constexpr inline uint32_t limit()
+    {
+        uint32_t ret = 0;
+
+        for(auto i = 0u; i < sizeof...(Methods); i++)
+            if(ret <= ids[i])
+                ret = ids[i] + 1;
+
+        return ret;
+    }
+
+    static constexpr inline bool distinct()
+    {
+        for(auto i = 0u; i < sizeof...(Methods); i++)
+            for(auto j = 0u; j < i; j++)
+                if(ids[i] == ids[j])
+                    return false;
+
+        return true;
+    }
+
+    static_assert(distinct(), "static method identifiers must be unique");
+
+    static constexpr size_t symbolCount = (size_t(Methods::hasSymbol) + ... + 0);
+
+    static constexpr inline auto makeSymbolTable()
+    {
+        if constexpr(symbolCount == 0)
+        {
+            return detail::PerfectHash<0>{};
+        }
+        else
+        {
+            uint64_t hashes[symbolCount] = {};
+            uint32_t ids[symbolCount] = {};
+            size_t i = 0;
+
+            ((Methods::hasSymbol ? (void)(hashes[i] = Methods::symbolHash, ids[i++] = Methods::id) : void()), ...);
+            return detail::PerfectHash<symbolCount>(hashes, ids);
+        }
+    }
+
+    /**
+     * Perfect hash table of the symbols of the methods, built at compile time.
+     */
+    static constexpr auto symbols = makeSymbolTable();
+    static_assert(symbols.ok, "static method symbols must be unique");
+
+public:
+    /**
+     * One more than the largest identifier used.
+     */
+    static constexpr uint32_t idLimit = limit();
+
+    /**
+     * Check if there is a method with the given identifier in the table.
+     */
+    static constexpr inline bool contains(uint32_t id) {
+        return ((id == Methods::id) || ... || false);
+    }
+
+    /**
+     * Invoke the method with the given identifier if there is one.
+     *
+     * Returns true and sets _result_ if the identifier is found in the table.
+     */
+    template<class S, class E>
+    static inline bool dispatch(uint32_t id, S& s, E& e, const char* &result) {
+        return ((id == Methods::id && ((result = Methods::invoke(s, e)), true)) || ... || false);
+    }
+
+    /**
+     * Find the identifier of the method whose symbol has the given hash.
+     *
+     * It takes a single probe of a perfect hash table, regardless of the number of symbols.
+     */
+    static constexpr inline bool find(uint64_t hash, uint32_t &id)
+    {
+        uint32_t v = 0;
+        const bool ok = symbols.find(hash, v);
+
+        if(ok)
+            id = v;
+
+        return ok;
+    }
+};
+
+}
+
+#endif /* _RPCSTATICDISPATCH_H_ */
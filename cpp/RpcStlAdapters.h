@@ -4,11 +4,14 @@
 #include "RpcFail.h"
 #include "RpcEndpoint.h"
 #include "RpcStlArray.h"
+#include "RpcSlotTableRegistry.h"
+#include "RpcSmallBufferPointer.h"
 
 #include <memory>
 #include <sstream>
 #include <unordered_map>
 #include <mutex>
+#include <type_traits>
 
 #include <cassert>
 
@@ -75,6 +78,12 @@ namespace detail
         }
     };
 
+    /**
+     * Registry used by the STL based endpoint, a slot table for call ids and a hash map for other keys (symbol hashes).
+     */
+    template<class K, class V>
+    using StlRegistry = std::conditional_t<std::is_same_v<K, uint32_t>, SlotTableRegistry<K, V>, HashMapRegistry<K, V>>;
+
     template<class T>
     struct StlAutoPointer: std::unique_ptr<T>
     {
@@ -95,14 +104,14 @@ namespace detail
  * the STL implementation. When tighter control over heap usage is a requirement alternate
  * implementations for the dependencies can be used.
  */
-template<class Io>
+template<class Io, class Derived = void>
 class StlEndpoint:
 	public Io,
 	public Endpoint<
-		detail::StlAutoPointer,
-		detail::HashMapRegistry,
+		detail::StlSmallBufferPointer,
+		detail::StlRegistry,
 		typename Io::InputAccessor,
-		StlEndpoint<Io>
+		std::conditional_t<std::is_void_v<Derived>, StlEndpoint<Io, Derived>, Derived>
 	>
 {
 public:
@@ -2,25 +2,87 @@
 #define _RPCSTLARRAY_H_
 
 #include "RpcStlTypes.h"
+#include "RpcArrayView.h"
 
 #include <string>
+#include <string_view>
 #include <vector>
 
 namespace rpc {
 
 /**
- * Serialization rules for std::string.
+ * Serialization rules for std::string (and std::pmr::string or other allocator variants).
  * 
  * NOTE: see CollectionTypeBase for generic rules of collection serialization.
  */
-template<> struct TypeInfo<std::string>: StlArrayBasedCollection<std::string, char> {};
+template<class A> struct TypeInfo<std::basic_string<char, std::char_traits<char>, A>>: 
+    StlArrayBasedCollection<std::basic_string<char, std::char_traits<char>, A>, char> {};
 
 /**
- * Serialization rules for std::vector.
+ * Serialization rules for std::string_view.
+ * 
+ * It can be used as a zero-copy alternative of std::string for the arguments of remotely callable
+ * methods, in which case it points into the message being processed (see ArrayView for details).
  * 
  * NOTE: see CollectionTypeBase for generic rules of collection serialization.
  */
-template<class T> struct TypeInfo<std::vector<T>>: StlArrayBasedCollection<std::vector<T>, T> {};
+template<> struct TypeInfo<std::string_view>: ContiguousViewTypeBase<std::string_view, char> {};
+
+/**
+ * Serialization rules for std::vector (and std::pmr::vector or other allocator variants).
+ * 
+ * NOTE: see CollectionTypeBase for generic rules of collection serialization.
+ */
+template<class T, class A> struct TypeInfo<std::vector<T, A>>: StlArrayBasedCollection<std::vector<T, A>, T> {};
+
+/**
+ * Serialization rules for std::vector<bool>.
+ * 
+ * The values are packed eight per byte, they are gathered into (and scattered from) 64 bit words
+ * one by one, as the layout of the storage of the vector is implementation specific.
+ * 
+ * NOTE: see PackedBitsTypeBase for the details of the encoding.
+ */
+template<class A> struct TypeInfo<std::vector<bool, A>>: PackedBitsTypeBase
+{
+    static constexpr inline size_t size(const std::vector<bool, A>& v) {
+        return packedSize((uint32_t)v.size());
+    }
+
+    template<class S> static inline bool write(S& s, const std::vector<bool, A>& v) 
+    {
+        return writeWords(s, (uint32_t)v.size(), [&v](uint32_t i) 
+        {
+            uint64_t w = 0;
+
+            for(uint32_t j = 0; j < 64 && i + j < v.size(); j++)
+                w |= uint64_t(v[i + j]) << j;
+
+            return w;
+        });
+    }
+
+    template<class S> static inline bool read(S& s, std::vector<bool, A>& v) 
+    {
+        uint32_t count;
+        if(!detail::readCollectionLength(s, count))
+            return false;
+
+        if constexpr(detail::has_peek<S>::value)
+        {
+            if(count && !s.peek((size_t(count) + 7) / 8))
+                return false;
+        }
+
+        v.resize(count);
+
+        return readWords(s, count, [&v](uint32_t i, uint64_t w) 
+        {
+            for(uint32_t j = 0; j < 64 && i + j < v.size(); j++)
+                v[i + j] = (w >> j) & 1;
+        });
+    }
+};
 
 }
 
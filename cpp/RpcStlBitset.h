@@ -0,0 +1,70 @@
+#ifndef _RPCSTLBITSET_H_
+#define _RPCSTLBITSET_H_
+
+#include "RpcStlTypes.h"
+
+#include <bitset>
+
+namespace rpc {
+
+/**
+ * Serialization rules for std::bitset.
+ *
+ * Bitsets of up to 64 bits are converted to and from a single word at once, larger
+ * ones are packed bit by bit. Only a packed boolean sequence of exactly the same
+ * length can be deserialized into a bitset.
+ *
+ * NOTE: see PackedBitsTypeBase for the details of the encoding.
+ */
+template<size_t N> struct TypeInfo<std::bitset<N>>: PackedBitsTypeBase
+{
+    static_assert(N <= uint32_t(-1));
+
+    static constexpr inline size_t size(const std::bitset<N>&) {
+        return packedSize(N);
+    }
+
+    template<class S> static inline bool write(S& s, const std::bitset<N>& v)
+    {
+        return writeWords(s, N, [&v](uint32_t i)
+        {
+            if constexpr(N <= 64)
+            {
+                return (uint64_t)v.to_ullong();
+            }
+            else
+            {
+                uint64_t w = 0;
+
+                for(uint32_t j = 0; j < 64 && i + j < N; j++)
+                    w |= uint64_t(v[i + j]) << j;
+
+                return w;
+            }
+        });
+    }
+
+    template<class S> static inline bool read(S& s, std::bitset<N>& v)
+    {
+        uint32_t count;
+        if(!VarUint4::read(s, count) || count != N)
+            return false;
+
+        return readWords(s, N, [&v](uint32_t i, uint64_t w)
+        {
+            if constexpr(N <= 64)
+            {
+                v = std::bitset<N>((unsigned long long)w);
+            }
+            else
+            {
+                for(uint32_t j = 0; j < 64 && i + j < N; j++)
+                    v[i + j] = (w >> j) & 1;
+            }
+        });
+    }
+};
+
+}
+
+#endif /* _RPCSTLBITSET_H_ */
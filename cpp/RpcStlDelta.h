@@ -0,0 +1,267 @@
+#ifndef _RPCSTLDELTA_H_
+#define _RPCSTLDELTA_H_
+
+#include "RpcStlTypes.h"
+
+#include <vector>
+#include <type_traits>
+
+namespace rpc {
+
+/**
+ * Integer sequence that is serialized in compact delta coded form.
+ *
+ * It is a std::vector that is meant to be used for sorted or slowly changing integer
+ * sequences (like timestamps or monotonically increasing identifiers), each element of
+ * which is encoded as the difference from the previous one (the first one from zero).
+ *
+ * NOTE: see TypeInfo<DeltaVector> for the details of the encoding.
+ */
+template<class T, class A = std::allocator<T>>
+struct DeltaVector: std::vector<T, A>
+{
+    static_assert(std::is_integral_v<T> && !std::is_same_v<T, bool>, "DeltaVector requires an integer element type");
+    using std::vector<T, A>::vector;
+};
+
+namespace detail
+{
+    /**
+     * Zigzag coding of the difference of consecutive integers, carried out at the width of the
+     * element type (so that wrapping around is handled properly and the results are compact).
+     */
+    template<class T>
+    struct DeltaCodec
+    {
+        using U = std::make_unsigned_t<T>;
+        using I = std::make_signed_t<T>;
+
+        static inline uint64_t encode(T prev, T next)
+        {
+            const auto d = (U)((U)next - (U)prev);
+            return (U)((U)(d << 1) ^ (U)((I)d >> (8 * sizeof(T) - 1)));
+        }
+
+        static inline T decode(T prev, uint64_t z) {
+            return (T)((U)prev + (U)((U)(z >> 1) ^ (U)-(U)(z & 1)));
+        }
+    };
+}
+
+/**
+ * Serialization rules for DeltaVector.
+ *
+ * The number of elements is written first using variable length encoding, then the difference
+ * of each element from the previous one (or from zero for the first one) zigzag coded - so
+ * that small negative differences are small as well - and written using the 64 bit variable
+ * length encoding (VarUint8). Thus for example a series of millisecond timestamps generated
+ * once a second takes up two bytes per element (after the first one) instead of eight.
+ *
+ * Runs of eight single byte differences, the common case, are encoded and decoded with a
+ * single eight byte store or load.
+ *
+ * It has its own signature (e.g. _<u8>_ for DeltaVector<uint64_t>), so it is not compatible
+ * with other collections of the same element type.
+ */
+template<class T, class A> struct TypeInfo<DeltaVector<T, A>>
+{
+    using Codec = detail::DeltaCodec<T>;
+
+    /**
+     * Number of elements encoded into a local buffer at once.
+     */
+    static constexpr uint32_t batchSize = 64;
+
+    template<class S> static constexpr inline decltype(auto) writeName(S&& s) {
+        return TypeInfo<T>::writeName(s << "<") << ">";
+    }
+
+    static constexpr inline size_t size(const DeltaVector<T, A>& v)
+    {
+        size_t ret = VarUint4::size((uint32_t)v.size());
+        T prev = 0;
+
+        for(const auto &x: v)
+        {
+            ret += VarUint8::size(Codec::encode(prev, x));
+            prev = x;
+        }
+
+        return ret;
+    }
+
+    /**
+     * Determining the size requires traversing the elements.
+     */
+    static constexpr inline bool hasCostlySize() {
+        return true;
+    }
+
+    static constexpr inline bool isConstSize() {
+        return false;
+    }
+
+    template<class S> static inline bool write(S& s, const DeltaVector<T, A>& v)
+    {
+        const uint32_t count = v.size();
+
+        if(!VarUint4::write(s, count))
+            return false;
+
+        T prev = 0;
+
+        if constexpr(detail::isLittleEndianHost && detail::has_bulk_access<S>::value)
+        {
+            char buffer[batchSize * VarUint8::maxLength];
+            uint64_t z[8];
+
+            for(auto it = v.data(), end = v.data() + count; it != end;)
+            {
+                auto p = buffer;
+
+                for(const auto batchEnd = (size_t(end - it) < batchSize) ? end : (it + batchSize); it != batchEnd;)
+                {
+                    if(8 <= batchEnd - it)
+                    {
+                        for(auto i = 0u; i < 8; i++)
+                            z[i] = Codec::encode(i ? it[i - 1] : prev, it[i]);
+
+                        if((z[0] | z[1] | z[2] | z[3] | z[4] | z[5] | z[6] | z[7]) < 0x80)
+                        {
+                            const uint64_t w = z[0] | z[1] << 8 | z[2] << 16 | z[3] << 24
+                                | z[4] << 32 | z[5] << 40 | z[6] << 48 | z[7] << 56;
+
+                            memcpy(p, &w, sizeof(w));
+                            p += sizeof(w);
+                        }
+                        else
+                        {
+                            for(auto i = 0u; i < 8; i++)
+                                p += VarUint8::encode(p, z[i]);
+                        }
+
+                        prev = it[7];
+                        it += 8;
+                    }
+                    else
+                    {
+                        p += VarUint8::encode(p, Codec::encode(prev, *it));
+                        prev = *it++;
+                    }
+                }
+
+                if(!s.write((const void*)buffer, (size_t)(p - buffer)))
+                    return false;
+            }
+        }
+        else
+        {
+            for(const auto &x: v)
+            {
+                if(!VarUint8::write(s, Codec::encode(prev, x)))
+                    return false;
+
+                prev = x;
+            }
+        }
+
+        return true;
+    }
+
+    template<class S> static inline bool read(S& s, DeltaVector<T, A>& v)
+    {
+        uint32_t count;
+        if(!detail::readCollectionLength(s, count))
+            return false;
+
+        // Every element takes at least one byte, so the count is validated before allocating.
+        if constexpr(detail::has_peek<S>::value)
+        {
+            if(count && !s.peek(count))
+                return false;
+        }
+
+        v.resize(count);
+        T prev = 0;
+
+        for(auto it = v.data(), end = v.data() + count; it != end;)
+        {
+            if constexpr(detail::isLittleEndianHost && detail::has_peek<S>::value)
+            {
+                if(8 <= end - it)
+                {
+                    if(auto p = s.peek(sizeof(uint64_t)))
+                    {
+                        uint64_t w;
+                        memcpy(&w, p, sizeof(w));
+
+                        if(!(w & 0x8080808080808080ull))
+                        {
+                            for(auto i = 0u; i < 8; i++, w >>= 8)
+                                it[i] = prev = Codec::decode(prev, w & 0xff);
+
+                            it += 8;
+
+                            if(!s.skip(sizeof(uint64_t)))
+                                return false;
+
+                            continue;
+                        }
+
+                        // Longer values are decoded directly if the whole group is surely available.
+                        if(auto q = s.peek(8 * VarUint8::maxLength))
+                        {
+                            size_t length = 0, i = 0;
+
+                            for(uint64_t z; i < 8; i++)
+                            {
+                                const auto l = VarUint8::decode(q + length, z);
+
+                                if(!l)
+                                    break;
+
+                                it[i] = prev = Codec::decode(prev, z);
+                                length += l;
+                            }
+
+                            if(i)
+                            {
+                                it += i;
+
+                                if(!s.skip(length))
+                                    return false;
+
+                                continue;
+                            }
+                        }
+                    }
+                }
+            }
+
+            uint64_t z;
+            if(!VarUint8::read(s, z))
+                return false;
+
+            *it++ = prev = Codec::decode(prev, z);
+        }
+
+        return true;
+    }
+
+    template<class S> static inline bool skip(S& s)
+    {
+        uint32_t count;
+        if(!VarUint4::read(s, count))
+            return false;
+
+        while(count--)
+            if(!VarUint8::skip(s))
+                return false;
+
+        return true;
+    }
+};
+
+}
+
+#endif /* _RPCSTLDELTA_H_ */
@@ -14,30 +14,30 @@ namespace rpc {
  * 
  * NOTE: see CollectionTypeBase for generic rules of collection serialization.
  */
-template<class T> struct TypeInfo<std::list<T>>: StlListBasedCollection<std::list<T>, T> {};
+template<class T, class A> struct TypeInfo<std::list<T, A>>: StlListBasedCollection<std::list<T, A>, T> {};
 
 /**
  * Serialization rules for std::deque.
  * 
  * NOTE: see CollectionTypeBase for generic rules of collection serialization.
  */
-template<class T> struct TypeInfo<std::deque<T>>: StlListBasedCollection<std::deque<T>, T> {};
+template<class T, class A> struct TypeInfo<std::deque<T, A>>: StlListBasedCollection<std::deque<T, A>, T> {};
 
 /**
  * Serialization rules for std::forward_list.
  * 
  * NOTE: see CollectionTypeBase for generic rules of collection serialization.
  */
-template<class T> struct TypeInfo<std::forward_list<T>>: StlCollection<std::forward_list<T>, T> 
+template<class T, class A> struct TypeInfo<std::forward_list<T, A>>: StlCollection<std::forward_list<T, A>, T> 
 {
-    template<class S> static inline bool write(S& s, const std::forward_list<T>& v) {
+    template<class S> static inline bool write(S& s, const std::forward_list<T, A>& v) {
         return TypeInfo::StlCollection::writeLengthAndContent(s, std::distance(v.begin(), v.end()), v);
     }
 
-    template<class S> static inline bool read(S& s, std::forward_list<T>& v) 
+    template<class S> static inline bool read(S& s, std::forward_list<T, A>& v) 
     { 
-        bool ok = TypeInfo::StlCollection::read(s, v, [](uint32_t count, std::forward_list<T>& v){
-            return std::front_insert_iterator<std::forward_list<T>>(v);
+        bool ok = TypeInfo::StlCollection::read(s, v, [](uint32_t count, std::forward_list<T, A>& v){
+            return std::front_insert_iterator<std::forward_list<T, A>>(v);
         });
 
         if(ok)
@@ -62,6 +62,10 @@ template<class T> struct TypeInfo<std::forward_list<T>>: StlCollection<std::forw
 
         return contentSize + VarUint4::size(count);
     }
+
+    static constexpr inline bool hasCostlySize() {
+        return true;
+    }
 };
 
 }
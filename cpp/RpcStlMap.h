@@ -13,28 +13,32 @@ namespace rpc {
  * 
  * NOTE: see CollectionTypeBase for generic rules of collection serialization.
  */
-template<class K, class V> struct TypeInfo<std::map<K, V>>: StlAssociativeCollection<std::map<K, V>, std::pair<K, V>> {};
+template<class K, class V, class L, class A> struct TypeInfo<std::map<K, V, L, A>>: 
+    StlAssociativeCollection<std::map<K, V, L, A>, std::pair<K, V>> {};
 
 /**
  * Serialization rules for std::multimap.
  * 
  * NOTE: see CollectionTypeBase for generic rules of collection serialization.
  */
-template<class K, class V> struct TypeInfo<std::multimap<K, V>>: StlAssociativeCollection<std::multimap<K, V>, std::pair<K, V>> {};
+template<class K, class V, class L, class A> struct TypeInfo<std::multimap<K, V, L, A>>: 
+    StlAssociativeCollection<std::multimap<K, V, L, A>, std::pair<K, V>> {};
 
 /**
  * Serialization rules for std::unordered_map.
  * 
  * NOTE: see CollectionTypeBase for generic rules of collection serialization.
  */
-template<class K, class V> struct TypeInfo<std::unordered_map<K, V>>: StlAssociativeCollection<std::unordered_map<K, V>, std::pair<K, V>> {};
+template<class K, class V, class H, class E, class A> struct TypeInfo<std::unordered_map<K, V, H, E, A>>: 
+    StlAssociativeCollection<std::unordered_map<K, V, H, E, A>, std::pair<K, V>> {};
 
 /**
  * Serialization rules for std::unordered_multimap.
  * 
  * NOTE: see CollectionTypeBase for generic rules of collection serialization.
  */
-template<class K, class V> struct TypeInfo<std::unordered_multimap<K, V>>: StlAssociativeCollection<std::unordered_multimap<K, V>, std::pair<K, V>> {};
+template<class K, class V, class H, class E, class A> struct TypeInfo<std::unordered_multimap<K, V, H, E, A>>: 
+    StlAssociativeCollection<std::unordered_multimap<K, V, H, E, A>, std::pair<K, V>> {};
     
 }
 
@@ -13,28 +13,28 @@ namespace rpc {
  * 
  * NOTE: see CollectionTypeBase for generic rules of collection serialization.
  */
-template<class T> struct TypeInfo<std::set<T>>: StlAssociativeCollection<std::set<T>, T> {};
+template<class T, class L, class A> struct TypeInfo<std::set<T, L, A>>: StlAssociativeCollection<std::set<T, L, A>, T> {};
 
 /**
  * Serialization rules for std::multiset.
  * 
  * NOTE: see CollectionTypeBase for generic rules of collection serialization.
  */
-template<class T> struct TypeInfo<std::multiset<T>>: StlAssociativeCollection<std::multiset<T>, T> {};
+template<class T, class L, class A> struct TypeInfo<std::multiset<T, L, A>>: StlAssociativeCollection<std::multiset<T, L, A>, T> {};
 
 /**
  * Serialization rules for std::unordered_set.
  * 
  * NOTE: see CollectionTypeBase for generic rules of collection serialization.
  */
-template<class T> struct TypeInfo<std::unordered_set<T>>: StlAssociativeCollection<std::unordered_set<T>, T> {};
+template<class T, class H, class E, class A> struct TypeInfo<std::unordered_set<T, H, E, A>>: StlAssociativeCollection<std::unordered_set<T, H, E, A>, T> {};
 
 /**
  * Serialization rules for std::unordered_multiset.
  * 
  * NOTE: see CollectionTypeBase for generic rules of collection serialization.
  */
-template<class T> struct TypeInfo<std::unordered_multiset<T>>: StlAssociativeCollection<std::unordered_multiset<T>, T> {};
+template<class T, class H, class E, class A> struct TypeInfo<std::unordered_multiset<T, H, E, A>>: StlAssociativeCollection<std::unordered_multiset<T, H, E, A>, T> {};
 
 }
 
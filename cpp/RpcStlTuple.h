@@ -24,7 +24,9 @@ template<class... Types> struct TypeInfo<std::tuple<Types...>>: AggregateTypeBas
     }
 
 	template<class S> static inline bool read(S& s, std::tuple<Types...>& v) { 
-        return std::apply([&s] (auto&&... x) { return (TypeInfo<Types>::read(s, x) && ... && true); }, v);
+        return TypeInfo::readMembers(s, v, [&v](auto& s) {
+            return std::apply([&s] (auto&&... x) { return (TypeInfo<Types>::read(s, x) && ... && true); }, v);
+        });
     }
 };
 
@@ -44,7 +46,9 @@ template<class T1, class T2> struct TypeInfo<std::pair<T1, T2>>: AggregateTypeBa
     }
 
 	template<class S> static inline bool read(S& s, std::pair<T1, T2>& v) { 
-        return TypeInfo<T1>::read(s, v.first) && TypeInfo<T2>::read(s, v.second); 
+        return TypeInfo::readMembers(s, v, [&v](auto& s) {
+            return TypeInfo<T1>::read(s, v.first) && TypeInfo<T2>::read(s, v.second); 
+        });
     }
 };
 
@@ -4,16 +4,83 @@
 #include "RpcTypeInfo.h"
 
 #include <iterator>
+#include <memory>
+#include <new>
+#include <type_traits>
 
 namespace rpc {
 
+namespace detail
+{
+    /**
+     * Checks if a stream accessor supplies a memory resource for the arguments being deserialized.
+     */
+    template<class S, class = void> struct has_memory_resource: false_type {};
+    template<class S> struct has_memory_resource<S, decltype(void(declval<S&>().memoryResource()))>: true_type {};
+
+    /**
+     * Temporary element of an STL container, constructed using the allocator of the container (so 
+     * that for example the nested containers of an element of a pmr container use the same memory 
+     * resource, and moving it into the container does not need to copy them).
+     */
+    template<class C, class T>
+    class StlTemporaryElement
+    {
+        using Allocator = typename std::allocator_traits<typename C::allocator_type>::template rebind_alloc<T>;
+        using Traits = std::allocator_traits<Allocator>;
+
+        Allocator allocator;
+        alignas(T) unsigned char storage[sizeof(T)];
+
+        inline T* ptr() {
+            return std::launder(reinterpret_cast<T*>(storage));
+        }
+
+    public:
+        inline StlTemporaryElement(const C& c): allocator(c.get_allocator()) {
+            Traits::construct(allocator, reinterpret_cast<T*>(storage));
+        }
+
+        inline ~StlTemporaryElement() {
+            Traits::destroy(allocator, ptr());
+        }
+
+        inline T& operator*() {
+            return *ptr();
+        }
+    };
+}
+
 /**
  * Common serialization rules for most STL containers.
  * 
+ * Containers with any allocator are supported, the elements are deserialized into 
+ * temporaries allocated using (a copy of) the allocator of the container.
+ * 
  * NOTE: see CollectionTypeBase for generic rules of collection serialization.
  */
 template<class C, class T> struct StlCollection: StlCompatibleCollectionTypeBase<C, T>
 {
+    /**
+     * Create an empty container for an argument being deserialized, using the memory resource
+     * supplied by the accessor if there is one and the allocator of the container can use it.
+     */
+    template<class S> static inline C make(S& s)
+    {
+        using A = typename C::allocator_type;
+
+        if constexpr(detail::has_memory_resource<S>::value)
+        {
+            if constexpr(std::is_constructible_v<A, decltype(s.memoryResource())>)
+            {
+                if(auto r = s.memoryResource())
+                    return C(A(r));
+            }
+        }
+
+        return C();
+    }
+
     template<class S> static inline bool writeLengthAndContent(S& s, uint32_t count, const C& v) 
     { 
         if(!VarUint4::write(s, count))
@@ -33,23 +100,31 @@ template<class C, class T> struct StlCollection: StlCompatibleCollectionTypeBase
     template<class S, class A> static inline bool read(S& s, C& v, A&& a)
     { 
         uint32_t count;
-        if(!VarUint4::read(s, count))
+        if(!detail::readCollectionLength(s, count))
             return false;
 
-        v.clear();
-        auto oit = a(count, v);
-
-        while(count--)
+        auto each = [&v, &a, count](auto& s)
         {
-            T v;
+            v.clear();
+            auto oit = a(count, v);
 
-            if(!TypeInfo<T>::read(s, v))
-                return false;
+            for(auto n = count; n--;)
+            {
+                detail::StlTemporaryElement<C, T> x(v);
 
-            *oit++ = std::move(v);
-        }
+                if(!TypeInfo<T>::read(s, *x))
+                    return false;
 
-        return true;
+                *oit++ = std::move(*x);
+            }
+
+            return true;
+        };
+
+        if constexpr(TypeInfo<T>::isConstSize())
+            return detail::boundedRun(s, detail::constSizeRun<T>(count), each);
+        else
+            return each(s);
     }
 };
 
@@ -73,16 +148,68 @@ template<class C, class T> struct StlAssociativeCollection: StlCollection<C, T>
 /**
  * Common serialization rules for std::vector and std::string.
  * 
+ * The elements are transferred as a single block of memory if their in-memory
+ * representation is identical to the serialized one (e.g. integers on a little
+ * endian host) and the stream accessor supports it. Elements serialized as a
+ * single VarUint4 value (e.g. Call objects) are encoded and decoded in batches.
+ *
  * NOTE: see CollectionTypeBase for generic rules of collection serialization.
  */
 template<class C, class T> struct StlArrayBasedCollection: StlCollection<C, T> 
 {
+    template<class S> static inline bool write(S& s, const C& v) 
+    {
+        if constexpr(detail::canBulkCopy<T, S> || detail::canBatchVarUint4<T, S>)
+        {
+            const uint32_t count = v.size();
+            return VarUint4::write(s, count) && detail::writeElements(s, v.data(), count);
+        }
+        else
+        {
+            return StlArrayBasedCollection::StlCollection::write(s, v);
+        }
+    }
+
     template<class S> static inline bool read(S& s, C& v) 
     { 
-        return StlArrayBasedCollection::StlCollection::read(s, v, [](uint32_t count, C& v){
-            v.reserve(count);
-            return std::back_insert_iterator<C>(v);
-        });
+        if constexpr(detail::canBulkCopy<T, S>)
+        {
+            uint32_t count;
+            if(!detail::readCollectionLength(s, count))
+                return false;
+
+            return detail::boundedRun(s, detail::constSizeRun<T>(count), [&v, count](auto& s) {
+                v.resize(count);
+                return detail::readElements(s, v.data(), count);
+            });
+        }
+        else if constexpr(detail::canBatchVarUint4<T, S>)
+        {
+            uint32_t count;
+            if(!detail::readCollectionLength(s, count))
+                return false;
+
+            // Every element takes at least one byte, so the count is validated before allocating.
+            if(count && !s.peek(count))
+                return false;
+
+            v.resize(count);
+            return detail::readElements(s, v.data(), count);
+        }
+        else
+        {
+            return StlArrayBasedCollection::StlCollection::read(s, v, [&s](uint32_t count, C& v){
+                v.reserve(detail::reservableCount<T>(s, count));
+                return std::back_insert_iterator<C>(v);
+            });
+        }
+    }
+
+    /**
+     * Summing the size of the elements stored contiguously is cheap compared to serializing them.
+     */
+    static constexpr inline bool hasCostlySize() {
+        return detail::has_costly_size<T>::value;
     }
 };
 
@@ -156,12 +156,7 @@ template<class T, class A> struct TypeInfo<StreamReader<T, A>>: CollectionTypeBa
             return false;
 
         v = StreamReader<T, A>(a, count);
-
-        for(auto i = 0u; i < count; i++)
-            if(!TypeInfo<T>::skip(a))
-                return false;
-
-        return true;    
+        return TypeInfo::skipElements(a, count);
     }
 };
 
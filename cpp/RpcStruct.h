@@ -5,11 +5,51 @@
 
 namespace rpc {
 
+template<auto member> struct StructMember;
+
 namespace detail {
+	/**
+	 * Checks if a struct can be aggregate initialized from values of the specified types.
+	 */
+	template<class Struct, class... Types>
+	static constexpr inline auto isBraceConstructible(int) -> decltype(void(Struct{declval<Types>()...}), true) { return true; }
 
-} // namespace detail
+	template<class Struct, class... Types>
+	static constexpr inline bool isBraceConstructible(...) { return false; }
 
-template<auto member> struct StructMember;
+	/**
+	 * Checks that the members are listed in the order of their declaration, by aggregate
+	 * initializing the struct with increasing values and reading them back via the members.
+	 */
+	template<class Struct, class... Members>
+	static constexpr inline bool isInDeclarationOrder()
+	{
+		uint32_t i = 0, j = 0;
+		const Struct s{static_cast<typename Members::T>(++i)...};
+		return ((Members::readAccess(s) == static_cast<typename Members::T>(++j)) && ... && true);
+	}
+
+	/**
+	 * Checks - in compile time - if the in-memory representation of a struct is identical to its serialized form.
+	 *
+	 * This is the case if it is a trivially copyable standard layout aggregate, its members are
+	 * primitive values that are themselves bulk copyable, there is no padding between them and they
+	 * are listed in the order of declaration (that is the same as their order in memory).
+	 */
+	template<class Struct, class... Members>
+	static constexpr inline bool hasWireLayout()
+	{
+		if constexpr(std::is_trivially_copyable_v<Struct> && std::is_standard_layout_v<Struct> && std::is_aggregate_v<Struct>
+				&& ((std::is_arithmetic_v<typename Members::T> && is_bulk_copyable<typename Members::T>::value) && ... && true)
+				&& sizeof(Struct) == (sizeof(typename Members::T) + ... + 0))
+		{
+			if constexpr(isBraceConstructible<Struct, typename Members::T...>(0))
+				return isInDeclarationOrder<Struct, Members...>();
+		}
+
+		return false;
+	}
+} // namespace detail
 
 template<class Struct, class Type, Type Struct::* mptr> struct StructMember<mptr>
 {
@@ -27,6 +67,9 @@ template<class Struct, class Type, Type Struct::* mptr> struct StructMember<mptr
 /**
  * Parametric serialization rules for structs.
  *
+ * If the in-memory representation of the struct matches its serialized form (see
+ * detail::hasWireLayout) it is copied as a block of raw bytes, and so are arrays of it.
+ *
  * NOTE: see AggregateTypeBase for generic rules of aggregate serialization.
  */
 
@@ -36,13 +79,27 @@ template<class Struct, class... Members> struct StructTypeInfo: AggregateTypeBas
         return (TypeInfo<typename Members::T>::size(Members::readAccess(v)) + ... + 0);
     }
 
-	template<class S> static inline bool write(S& s, const Struct& v) {
-        return (TypeInfo<typename Members::T>::write(s, Members::readAccess(v)) && ... && true);
-    }
+	static constexpr inline bool isBulkCopyable() {
+		return detail::hasWireLayout<Struct, Members...>();
+	}
 
-	template<class S> static inline bool read(S& s, Struct& v) {
-        return (TypeInfo<typename Members::T>::read(s, Members::writeAccess(v)) && ... && true);
-    }
+	template<class S> static inline bool write(S& s, const Struct& v)
+	{
+		if constexpr(isBulkCopyable() && detail::has_bulk_access<S>::value)
+			return s.write((const void*)&v, sizeof(Struct));
+		else
+			return (TypeInfo<typename Members::T>::write(s, Members::readAccess(v)) && ... && true);
+	}
+
+	template<class S> static inline bool read(S& s, Struct& v)
+	{
+		if constexpr(isBulkCopyable() && detail::has_bulk_access<S>::value)
+			return s.read((void*)&v, sizeof(Struct));
+		else
+			return StructTypeInfo::readMembers(s, v, [&v](auto& s) {
+				return (TypeInfo<typename Members::T>::read(s, Members::writeAccess(v)) && ... && true);
+			});
+	}
 };
 
 
@@ -7,9 +7,259 @@
 
 #include <stddef.h>
 #include <stdint.h>
+#include <string.h>
 
 namespace rpc {
 
+namespace detail
+{
+	/**
+	 * Checks if the in-memory representation of a type is identical to its serialized form.
+	 */
+	template<class T, class = void> struct is_bulk_copyable: false_type {};
+	template<class T> struct is_bulk_copyable<T, decltype(void(TypeInfo<T>::isBulkCopyable()))> {
+		static constexpr auto value = TypeInfo<T>::isBulkCopyable();
+	};
+
+	/**
+	 * Checks if determining the serialized size of a value requires traversing it (e.g. a list of strings).
+	 */
+	template<class T, class = void> struct has_costly_size: false_type {};
+	template<class T> struct has_costly_size<T, decltype(void(TypeInfo<T>::hasCostlySize()))> {
+		static constexpr auto value = TypeInfo<T>::hasCostlySize();
+	};
+
+	/**
+	 * Checks if a stream accessor supports bulk transfer of raw bytes.
+	 */
+	template<class S, class = void> struct has_bulk_access: false_type {};
+	template<class S> struct has_bulk_access<S, decltype(void(declval<S>().write((const void*)nullptr, size_t(0))))>: true_type {};
+
+	/**
+	 * Checks if a stream accessor validates the bounds of each access and can provide an unchecked
+	 * accessor for a run of data after validating it all at once.
+	 */
+	template<class S, class = void> struct has_bounded_run: false_type {};
+	template<class S> struct has_bounded_run<S, decltype(void(declval<typename S::Unchecked>()))>: true_type {};
+
+	/**
+	 * Checks if a stream accessor can tell the number of bytes left to be read.
+	 */
+	template<class S, class = void> struct has_remaining: false_type {};
+	template<class S> struct has_remaining<S, decltype(void(declval<S&>().remaining()))>: true_type {};
+
+	/**
+	 * Checks if a stream accessor imposes a limit on the number of elements of collections.
+	 */
+	template<class S, class = void> struct has_collection_limit: false_type {};
+	template<class S> struct has_collection_limit<S, decltype(void(declval<S&>().collectionLimit()))>: true_type {};
+
+	/**
+	 * Read the number of elements of a collection, checking it against the limit imposed by the accessor (if any).
+	 */
+	template<class S>
+	static inline bool readCollectionLength(S& s, uint32_t &count)
+	{
+		if(!VarUint4::read(s, count))
+			return false;
+
+		if constexpr(has_collection_limit<S>::value)
+			return count <= s.collectionLimit();
+		else
+			return true;
+	}
+
+	/**
+	 * Process a run of data of known length using a single bounds check if the accessor supports it.
+	 *
+	 * The callback is invoked with the accessor to be used for processing the data of the run.
+	 */
+	template<class S, class C>
+	static inline bool boundedRun(S& s, size_t length, C&& c)
+	{
+		if constexpr(has_bounded_run<S>::value)
+			return s.run(length, rpc::forward<C>(c));
+		else
+			return c(s);
+	}
+
+	/**
+	 * Length of a run of elements of a constant-size type (saturated instead of overflowing).
+	 */
+	template<class T>
+	static inline size_t constSizeRun(uint32_t count, const T& v = T())
+	{
+		const auto size = TypeInfo<T>::size(v);
+		return (size && size_t(-1) / size < count) ? size_t(-1) : count * size;
+	}
+
+	/**
+	 * Determine the number of elements of a collection that can be reserved up front when deserializing it.
+	 *
+	 * The count read from the input is not trusted, it is limited to the number of elements that 
+	 * could be stored in the rest of the input (if the accessor can tell its size), so that a bogus 
+	 * count can not trigger a huge allocation. Beyond that the collection is grown as the elements 
+	 * are actually read.
+	 */
+	template<class T, class S>
+	static inline uint32_t reservableCount(S& s, uint32_t count)
+	{
+		if constexpr(has_remaining<S>::value)
+		{
+			// Values of types that are not constant-size take at least one byte.
+			size_t minSize = 1;
+
+			if constexpr(TypeInfo<T>::isConstSize())
+				minSize = TypeInfo<T>::size(T());
+
+			if(minSize)
+			{
+				const auto max = s.remaining() / minSize;
+				return (max < count) ? (uint32_t)max : count;
+			}
+		}
+
+		return count;
+	}
+
+	/**
+	 * Checks if an array of values can be transferred as a block of raw bytes via a stream accessor.
+	 */
+	template<class T, class S> static constexpr bool canBulkCopy = is_bulk_copyable<T>::value && has_bulk_access<S>::value;
+
+	/**
+	 * Checks if a type is serialized as a single VarUint4 value.
+	 */
+	template<class T, class = void> struct is_varuint4_coded: false_type {};
+	template<class T> struct is_varuint4_coded<T, decltype(void(TypeInfo<T>::varUint4Value(declval<const T&>())))>: true_type {};
+
+	/**
+	 * Checks if an array of VarUint4 coded values can be encoded and decoded in batches via a stream accessor.
+	 */
+	template<class T, class S> static constexpr bool canBatchVarUint4 = 
+		is_varuint4_coded<T>::value && has_bulk_access<S>::value && has_peek<S>::value && isLittleEndianHost;
+
+	/**
+	 * Number of VarUint4 values encoded or decoded at once.
+	 */
+	static constexpr uint32_t varUint4BatchSize = 64;
+
+	/**
+	 * Write an array of VarUint4 coded values, encoding them in batches into a local buffer.
+	 */
+	template<class T, class S>
+	static inline bool writeVarUint4Elements(S& s, const T* data, uint32_t count)
+	{
+		uint32_t values[varUint4BatchSize];
+		char encoded[varUint4BatchSize * 5 + 3];
+
+		for(uint32_t done = 0; done < count;)
+		{
+			const auto n = (count - done < varUint4BatchSize) ? count - done : varUint4BatchSize;
+
+			for(auto i = 0u; i < n; i++)
+				values[i] = TypeInfo<T>::varUint4Value(data[done + i]);
+
+			if(!s.write((const void*)encoded, VarUint4::encodeBatch(encoded, values, n)))
+				return false;
+
+			done += n;
+		}
+
+		return true;
+	}
+
+	/**
+	 * Read an array of VarUint4 coded values, decoding them in batches directly from the stream.
+	 *
+	 * Values near the end of the stream, where a batch can not be decoded without the 
+	 * risk of reading past it, are decoded one by one.
+	 */
+	template<class T, class S>
+	static inline bool readVarUint4Elements(S& s, T* data, uint32_t count)
+	{
+		uint32_t values[varUint4BatchSize];
+
+		for(uint32_t done = 0; done < count;)
+		{
+			const auto n = (count - done < varUint4BatchSize) ? count - done : varUint4BatchSize;
+
+			if(auto p = s.peek(n * 5 + 3))
+			{
+				const auto length = VarUint4::decodeBatch(p, values, n);
+
+				for(auto i = 0u; i < n; i++)
+					TypeInfo<T>::setVarUint4Value(data[done + i], values[i]);
+
+				if(!s.skip(length))
+					return false;
+
+				done += n;
+			}
+			else if(!TypeInfo<T>::read(s, data[done++]))
+			{
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	/**
+	 * Write an array of values, using a single bulk transfer or batched encoding if possible.
+	 *
+	 * For other constant-size types the available space is checked once for the whole array.
+	 */
+	template<class T, class S>
+	static inline bool writeElements(S& s, const T* data, uint32_t count)
+	{
+		auto each = [data, count](auto& s)
+		{
+			for(auto i = 0u; i < count; i++)
+				if(!TypeInfo<T>::write(s, data[i]))
+					return false;
+
+			return true;
+		};
+
+		if constexpr(canBulkCopy<T, S>)
+			return !count || s.write((const void*)data, count * sizeof(T));
+		else if constexpr(canBatchVarUint4<T, S>)
+			return writeVarUint4Elements(s, data, count);
+		else if constexpr(TypeInfo<T>::isConstSize())
+			return !count || boundedRun(s, constSizeRun(count, *data), each);
+		else
+			return each(s);
+	}
+
+	/**
+	 * Read an array of values, using a single bulk transfer or batched decoding if possible.
+	 *
+	 * For other constant-size types the available data is checked once for the whole array.
+	 */
+	template<class T, class S>
+	static inline bool readElements(S& s, T* data, uint32_t count)
+	{
+		auto each = [data, count](auto& s)
+		{
+			for(auto i = 0u; i < count; i++)
+				if(!TypeInfo<T>::read(s, data[i]))
+					return false;
+
+			return true;
+		};
+
+		if constexpr(canBulkCopy<T, S>)
+			return !count || s.read((void*)data, count * sizeof(T));
+		else if constexpr(canBatchVarUint4<T, S>)
+			return readVarUint4Elements(s, data, count);
+		else if constexpr(TypeInfo<T>::isConstSize())
+			return !count || boundedRun(s, constSizeRun(count, *data), each);
+		else
+			return each(s);
+	}
+}
+
 /**
  * Serialization rules for boolean values.
  * 
@@ -40,6 +290,7 @@ template<class T, char prefix> struct PrimitveIntegerTypeInfoBase
 	template<class S> static inline bool skip(S& s) { return s.skip(sizeof(T)); }
 	static constexpr inline size_t size(...) { return sizeof(T); }
 	static constexpr inline bool isConstSize() { return true; }
+	static constexpr inline bool isBulkCopyable() { return sizeof(T) == 1 || detail::isLittleEndianHost; }
 };
 
 
@@ -130,7 +381,8 @@ template<size_t n> class CTStr;
 /**
  * Serialization rules for Call objects.
  * 
- * The call object's 32 bit identifier field is encoded using variable length encoding.
+ * The call object's 32 bit identifier field is encoded using variable length encoding, 
+ * arrays of them are encoded and decoded in batches (see writeElements and readElements).
  */
 template<class... Args> struct TypeInfo<Call<Args...>> 
 {
@@ -140,6 +392,8 @@ template<class... Args> struct TypeInfo<Call<Args...>>
 	template<class S> static inline bool skip(S& s) { return ::rpc::VarUint4::skip(s); }
 	static constexpr inline size_t size(const Call<Args...> &v) { return ::rpc::VarUint4::size(v.id); }
 	static constexpr inline bool isConstSize() { return false; }
+	static constexpr inline uint32_t varUint4Value(const Call<Args...> &v) { return v.id; }
+	static constexpr inline void setVarUint4Value(Call<Args...> &v, uint32_t id) { v.id = id; }
 };
 
 /**
@@ -150,22 +404,178 @@ template<class... Args> struct TypeInfo<Call<Args...>>
  */
 template<class T> struct CollectionTypeBase: CollectionPlaceholder<T>
 { 
+	/**
+	 * Skip a number of elements, using a single step if they are constant-size.
+	 */
+	template<class S> static inline bool skipElements(S& s, uint32_t count)
+    {
+        if constexpr(TypeInfo<T>::isConstSize())
+        {
+            return s.skip(detail::constSizeRun<T>(count));
+        }
+        else
+        {
+            while(count--)
+                if(!TypeInfo<T>::skip(s))
+                    return false;
+
+            return true;
+        }
+    }
+
 	template<class S> static inline bool skip(S& s)
     {
         uint32_t count;
         if(!::rpc::VarUint4::read(s, count))
             return false;
 
-        while(count--)
-            if(!TypeInfo<T>::skip(s))
-                return false;
-
-        return true;
+        return skipElements(s, count);
     }
 
 	static constexpr inline bool isConstSize() { return false; }
 };
 
+/**
+ * Common serialization rules for packed boolean sequences.
+ * 
+ * The number of values is written first using variable length encoding, then the values
+ * packed eight per byte, starting at the least significant bit of the first byte (the 
+ * unused bits of the last byte are zero).
+ * 
+ * The values are transferred 64 at a time via callbacks, that receive the index of the 
+ * first value of the group (and the packed group itself when reading).
+ */
+struct PackedBitsTypeBase
+{
+	/**
+	 * Number of 64 bit groups buffered locally for a single transfer.
+	 */
+	static constexpr uint32_t batchWords = 64;
+
+	template<class S> static constexpr inline decltype(auto) writeName(S&& s) { return s << "B"; }
+
+	static constexpr inline size_t packedSize(uint32_t count) {
+		return (size_t(count) + 7) / 8 + ::rpc::VarUint4::size(count);
+	}
+
+	template<class S> static inline bool skip(S& s)
+	{
+		uint32_t count;
+		if(!::rpc::VarUint4::read(s, count))
+			return false;
+
+		return s.skip((size_t(count) + 7) / 8);
+	}
+
+	static constexpr inline bool isConstSize() { return false; }
+
+	template<class S, class C> static inline bool writeWords(S& s, uint32_t count, C&& word)
+	{
+		if(!::rpc::VarUint4::write(s, count))
+			return false;
+
+		char buffer[batchWords * sizeof(uint64_t)];
+
+		for(size_t i = 0; i < count;)
+		{
+			auto p = buffer;
+
+			for(auto j = 0u; j < batchWords && i < count; j++, i += 64)
+			{
+				const auto n = count - i;
+				const auto w = word((uint32_t)i);
+
+				if(detail::isLittleEndianHost && 64 <= n)
+				{
+					memcpy(p, &w, sizeof(w));
+					p += sizeof(w);
+				}
+				else
+				{
+					for(auto k = 0u; 8 * k < n && k < sizeof(w); k++)
+						*p++ = (char)(((n < 64) ? (w & ((uint64_t(1) << n) - 1)) : w) >> (8 * k));
+				}
+			}
+
+			if(!writeBytes(s, buffer, size_t(p - buffer)))
+				return false;
+		}
+
+		return true;
+	}
+
+	template<class S, class C> static inline bool readWords(S& s, uint32_t count, C&& word)
+	{
+		char buffer[batchWords * sizeof(uint64_t)];
+
+		for(size_t i = 0; i < count;)
+		{
+			const size_t remaining = count - i;
+			const auto bytes = (remaining < batchWords * 64) ? (remaining + 7) / 8 : sizeof(buffer);
+
+			if(!readBytes(s, buffer, bytes))
+				return false;
+
+			for(auto p = buffer; p != buffer + bytes; i += 64)
+			{
+				const auto n = count - i;
+				uint64_t w = 0;
+
+				if(detail::isLittleEndianHost && 64 <= n)
+				{
+					memcpy(&w, p, sizeof(w));
+					p += sizeof(w);
+				}
+				else
+				{
+					for(auto k = 0u; 8 * k < n && k < sizeof(w); k++)
+						w |= uint64_t((uint8_t)*p++) << (8 * k);
+
+					if(n < 64)
+						w &= (uint64_t(1) << n) - 1;
+				}
+
+				word((uint32_t)i, w);
+			}
+		}
+
+		return true;
+	}
+
+private:
+	template<class S> static inline bool writeBytes(S& s, const char* data, size_t length)
+	{
+		if constexpr(detail::has_bulk_access<S>::value)
+		{
+			return s.write((const void*)data, length);
+		}
+		else
+		{
+			for(auto p = data; p != data + length; p++)
+				if(!s.write((uint8_t)*p))
+					return false;
+
+			return true;
+		}
+	}
+
+	template<class S> static inline bool readBytes(S& s, char* data, size_t length)
+	{
+		if constexpr(detail::has_bulk_access<S>::value)
+		{
+			return s.read((void*)data, length);
+		}
+		else
+		{
+			for(auto p = data; p != data + length; p++)
+				if(!s.read(*(uint8_t*)p))
+					return false;
+
+			return true;
+		}
+	}
+};
+
 /**
  * Common serialization rules for STL-like containers.
  * 
@@ -194,6 +604,13 @@ template<class C, class T> struct StlCompatibleCollectionTypeBase: CollectionTyp
 
         return contentSize + ::rpc::VarUint4::size(count);
     }
+
+    /**
+     * The size of the elements needs to be summed one by one unless they are constant-size.
+     */
+    static constexpr inline bool hasCostlySize() {
+        return !TypeInfo<T>::isConstSize();
+    }
 };
 
 /**
@@ -207,13 +624,32 @@ template<class... Types> struct AggregateTypeBase
 		return SignatureGenerator<Types...>::writeTypes(s << "{") << "}";
 	}
 
-	template<class S> static inline bool skip(S& s) { 
-        return (TypeInfo<Types>::skip(s) && ... && true);
-    }
+	template<class S> static inline bool skip(S& s) 
+	{ 
+		if constexpr(isConstSize())
+			return s.skip((TypeInfo<Types>::size(Types()) + ... + 0));
+		else
+			return (TypeInfo<Types>::skip(s) && ... && true);
+	}
 
 	static constexpr inline bool isConstSize() { 
         return (TypeInfo<Types>::isConstSize() && ... && true);
 	}
+
+	static constexpr inline bool hasCostlySize() { 
+        return (detail::has_costly_size<Types>::value || ... || false);
+	}
+
+	/**
+	 * Read the members via the callback, checking the available data only once if all of them are constant-size.
+	 */
+	template<class S, class V, class C> static inline bool readMembers(S& s, const V& v, C&& c)
+	{
+		if constexpr(isConstSize())
+			return detail::boundedRun(s, TypeInfo<V>::size(v), rpc::forward<C>(c));
+		else
+			return c(s);
+	}
 };
 
 /**
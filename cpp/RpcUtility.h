@@ -5,6 +5,12 @@ namespace rpc {
 
 namespace detail  
 {
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+    static constexpr bool isLittleEndianHost = true;
+#else
+    static constexpr bool isLittleEndianHost = false;
+#endif
+
     struct false_type { static constexpr auto value = false; };
     struct true_type { static constexpr auto value = true; };
     template<class> struct is_lvalue_reference: public false_type { };
@@ -1,11 +1,27 @@
 #ifndef _RPCVARINT_H_
 #define _RPCVARINT_H_
 
+#include "RpcUtility.h"
+
 #include <stddef.h>
 #include <stdint.h>
+#include <string.h>
+
+#if defined(__BMI2__)
+#include <immintrin.h>
+#endif
 
 namespace rpc {
 
+namespace detail
+{
+	/**
+	 * Checks if a stream accessor can provide direct access to a number of readable bytes.
+	 */
+	template<class S, class = void> struct has_peek: false_type {};
+	template<class S> struct has_peek<S, decltype(void(declval<S>().peek(size_t(0))))>: true_type {};
+}
+
 /**
  * Variable length encoding for unsigned 32 bit values.
  * 
@@ -46,11 +62,156 @@ struct VarUint4
 		return s.write(uint8_t(v));
 	}
 
+	/**
+	 * Encode a value into a buffer with at least eight writable bytes, using a single 
+	 * store and no data dependent branches.
+	 * 
+	 * Returns the length of the encoded value.
+	 * 
+	 * NOTE: only usable on little endian hosts.
+	 */
+	static inline size_t encode(char* p, uint32_t v)
+	{
+		const auto length = (size_t)(32 - __builtin_clz(v | 1) + 6) / 7;
+
+		const uint64_t bits = (v & 0x7f) 
+			| ((uint64_t)(v & 0x3f80) << 1) 
+			| ((uint64_t)(v & 0x1fc000) << 2) 
+			| ((uint64_t)(v & 0xfe00000) << 3) 
+			| ((uint64_t)(v & 0xf0000000) << 4);
+
+		const uint64_t w = bits | (0x80808080ull & ((1ull << (8 * (length - 1))) - 1));
+		memcpy(p, &w, sizeof(w));
+		return length;
+	}
+
+	/**
+	 * Encode an array of values into a buffer with at least 5 * n + 3 writable bytes.
+	 * 
+	 * Runs of eight single byte values are stored at once.
+	 * 
+	 * Returns the total length of the encoded values.
+	 * 
+	 * NOTE: only usable on little endian hosts.
+	 */
+	static inline size_t encodeBatch(char* p, const uint32_t* v, size_t n)
+	{
+		const auto start = p;
+		const auto end = v + n;
+
+		for(; 8 <= end - v; v += 8)
+		{
+			if((v[0] | v[1] | v[2] | v[3] | v[4] | v[5] | v[6] | v[7]) < 0x80)
+			{
+				const uint64_t w = (uint64_t)v[0] | (uint64_t)v[1] << 8 | (uint64_t)v[2] << 16 | (uint64_t)v[3] << 24
+					| (uint64_t)v[4] << 32 | (uint64_t)v[5] << 40 | (uint64_t)v[6] << 48 | (uint64_t)v[7] << 56;
+
+				memcpy(p, &w, sizeof(w));
+				p += sizeof(w);
+			}
+			else
+			{
+				p += encode(p, v[0]); p += encode(p, v[1]); p += encode(p, v[2]); p += encode(p, v[3]);
+				p += encode(p, v[4]); p += encode(p, v[5]); p += encode(p, v[6]); p += encode(p, v[7]);
+			}
+		}
+
+		while(v != end)
+			p += encode(p, *v++);
+
+		return p - start;
+	}
+
+	/**
+	 * Decode a value from a buffer with at least eight readable bytes, using a single 
+	 * load and no data dependent branches.
+	 * 
+	 * Returns the length of the encoded value.
+	 * 
+	 * NOTE: only usable on little endian hosts.
+	 */
+	static inline size_t decode(const char* p, uint32_t &v)
+	{
+		uint64_t w;
+		memcpy(&w, p, sizeof(w));
+
+		const auto stops = ~w & 0x80808080u;
+		const auto length = stops ? (size_t(__builtin_ctzll(stops)) >> 3) + 1 : 5;
+
+#if defined(__BMI2__)
+		const auto bits = (uint32_t)_pext_u64(w, 0x0f7f7f7f7full);
+#else
+		const auto bits = (uint32_t)((w & 0x7f) | ((w >> 1) & 0x3f80) | ((w >> 2) & 0x1fc000) | ((w >> 3) & 0xfe00000) | ((w >> 4) & 0xf0000000));
+#endif
+
+		v = (length < 5) ? (bits & ((1u << (7 * length)) - 1)) : bits;
+		return length;
+	}
+
+	/**
+	 * Decode an array of values from a buffer with at least 5 * n + 3 readable bytes (i.e. enough 
+	 * for the longest possible encoding plus the overhang of the eight byte loads).
+	 * 
+	 * Runs of eight single byte values are loaded at once.
+	 * 
+	 * Returns the total length of the encoded values.
+	 * 
+	 * NOTE: only usable on little endian hosts.
+	 */
+	static inline size_t decodeBatch(const char* p, uint32_t* v, size_t n)
+	{
+		const auto start = p;
+		const auto end = v + n;
+
+		while(8 <= end - v)
+		{
+			uint64_t w;
+			memcpy(&w, p, sizeof(w));
+
+			if(!(w & 0x8080808080808080ull))
+			{
+				v[0] = (uint8_t)p[0]; v[1] = (uint8_t)p[1]; v[2] = (uint8_t)p[2]; v[3] = (uint8_t)p[3];
+				v[4] = (uint8_t)p[4]; v[5] = (uint8_t)p[5]; v[6] = (uint8_t)p[6]; v[7] = (uint8_t)p[7];
+
+				p += sizeof(w);
+				v += 8;
+			}
+			else
+			{
+				p += decode(p, *v++);
+			}
+		}
+
+		while(v != end)
+			p += decode(p, *v++);
+
+		return p - start;
+	}
+
 	/**
 	 * Read 32 bit unsigned variable length coded value from stream.
+	 * 
+	 * If the accessor can provide direct access to the data (and there is enough 
+	 * of it left) the value is decoded at once, otherwise byte-by-byte.
 	 */
 	template<class S> static inline bool read(S& s, uint32_t &v)
 	{
+		if constexpr(detail::isLittleEndianHost && detail::has_peek<S>::value)
+		{
+			if(auto p = s.peek(sizeof(uint64_t)))
+			{
+				// Single byte values are the most common, handled separately to keep
+				// the position of the next value independent of the loaded data.
+				if(!(*p & 0x80))
+				{
+					v = (uint8_t)*p;
+					return s.skip(1);
+				}
+
+				return s.skip(decode(p, v));
+			}
+		}
+
 		uint8_t nBytes = 0;
 		v = 0;
 
@@ -83,6 +244,15 @@ struct VarUint4
 	 */
 	template<class S> static inline bool skip(S& s)
 	{
+		if constexpr(detail::isLittleEndianHost && detail::has_peek<S>::value)
+		{
+			if(auto p = s.peek(sizeof(uint64_t)))
+			{
+				uint32_t v;
+				return s.skip(decode(p, v));
+			}
+		}
+
 		uint8_t d, nBytes = 0;
 
 		while(s.read(d))
@@ -137,6 +307,156 @@ struct VarUint4
 	};
 };
 
+/**
+ * Variable length encoding for unsigned 64 bit values.
+ * 
+ * Uses little endian base 128 (LEB128) encoding, the same as VarUint4 (the encodings of
+ * values that fit into 32 bits are identical), taking up to ten bytes.
+ */
+struct VarUint8
+{
+	static constexpr size_t maxLength = 10;
+
+	/**
+	 * Determine the corresponding encoded byte sequence length for a value.
+	 */
+	static constexpr inline size_t size(uint64_t v) {
+		return (size_t)(64 - __builtin_clzll(v | 1) + 6) / 7;
+	}
+
+	/**
+	 * Write 64 bit unsigned value to stream using variable length encoding.
+	 */
+	template<class S> static inline bool write(S& s, uint64_t v) 
+	{
+		while(v >= 0x80)
+		{
+			if(!s.write(uint8_t(v | 0x80)))
+				return false;
+
+			v >>= 7;
+		}
+
+		return s.write(uint8_t(v));
+	}
+
+	/**
+	 * Encode a value into a buffer with at least ten writable bytes. Values taking up to 
+	 * eight bytes are stored at once, without data dependent branches.
+	 * 
+	 * Returns the length of the encoded value.
+	 * 
+	 * NOTE: only usable on little endian hosts.
+	 */
+	static inline size_t encode(char* p, uint64_t v)
+	{
+		const auto length = size(v);
+
+		if(length <= sizeof(uint64_t))
+		{
+			const uint64_t bits = (v & 0x7f) 
+				| ((v << 1) & 0x7f00) 
+				| ((v << 2) & 0x7f0000) 
+				| ((v << 3) & 0x7f000000) 
+				| ((v << 4) & 0x7f00000000ull) 
+				| ((v << 5) & 0x7f0000000000ull) 
+				| ((v << 6) & 0x7f000000000000ull) 
+				| ((v << 7) & 0x7f00000000000000ull);
+
+			const uint64_t w = bits | (0x8080808080808080ull & (((1ull << (8 * (length - 1))) - 1)));
+			memcpy(p, &w, sizeof(w));
+			return length;
+		}
+
+		for(auto i = 0u; i < length - 1; i++, v >>= 7)
+			p[i] = (char)(v | 0x80);
+
+		p[length - 1] = (char)v;
+		return length;
+	}
+
+	/**
+	 * Decode a value from a buffer with at least eight readable bytes, using a single load.
+	 * 
+	 * Returns the length of the encoded value or zero if it is longer than eight bytes, in 
+	 * which case it needs to be read byte-by-byte.
+	 * 
+	 * NOTE: only usable on little endian hosts.
+	 */
+	static inline size_t decode(const char* p, uint64_t &v)
+	{
+		uint64_t w;
+		memcpy(&w, p, sizeof(w));
+
+		const auto stops = ~w & 0x8080808080808080ull;
+
+		if(!stops)
+			return 0;
+
+		const auto length = (size_t(__builtin_ctzll(stops)) >> 3) + 1;
+
+#if defined(__BMI2__)
+		const auto bits = _pext_u64(w, 0x7f7f7f7f7f7f7f7full);
+#else
+		const auto bits = (w & 0x7f) 
+			| ((w >> 1) & 0x3f80) 
+			| ((w >> 2) & 0x1fc000) 
+			| ((w >> 3) & 0xfe00000) 
+			| ((w >> 4) & 0x7f0000000ull) 
+			| ((w >> 5) & 0x3f800000000ull) 
+			| ((w >> 6) & 0x1fc0000000000ull) 
+			| ((w >> 7) & 0xfe000000000000ull);
+#endif
+
+		v = (length < 8) ? (bits & ((1ull << (7 * length)) - 1)) : bits;
+		return length;
+	}
+
+	/**
+	 * Read 64 bit unsigned variable length coded value from stream.
+	 * 
+	 * If the accessor can provide direct access to the data (and there is enough 
+	 * of it left) values up to eight bytes long are decoded at once, otherwise 
+	 * byte-by-byte.
+	 */
+	template<class S> static inline bool read(S& s, uint64_t &v)
+	{
+		if constexpr(detail::isLittleEndianHost && detail::has_peek<S>::value)
+		{
+			if(auto p = s.peek(sizeof(uint64_t)))
+			{
+				if(auto length = decode(p, v))
+					return s.skip(length);
+			}
+		}
+
+		v = 0;
+
+		for(auto shift = 0u; shift < 7 * maxLength; shift += 7)
+		{
+			uint8_t d;
+			if(!s.read(d))
+				return false;
+
+			v |= (uint64_t)(d & 0x7f) << shift;
+
+			if(!(d & 0x80))
+				return true;
+		}
+
+		return false;
+	}
+
+	/**
+	 * Skip a variable length encoded value in stream.
+	 */
+	template<class S> static inline bool skip(S& s)
+	{
+		uint64_t v;
+		return read(s, v);
+	}
+};
+
 }
 
 #endif /* _RPCVARINT_H_ */
@@ -0,0 +1,102 @@
+/**
+ * Measures the per-message cost of sending messages over a unix socketpair using the
+ * IoUringAdapter versus the FdStreamAdapter, with and without corking.
+ *
+ * One thread sends, an other one receives using the same kind of adapter on the other end.
+ *
+ * Build and run (from this directory, needs a kernel with io_uring enabled):
+ *
+ *     g++ -std=c++17 -O2 -pthread -I.. IoUringVsFdStream.cpp -o IoUringVsFdStream && ./IoUringVsFdStream
+ */
+
+#include "RpcIoUringAdapter.h"
+
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <cstdio>
+
+#include <sys/socket.h>
+
+static constexpr size_t messageCount = 100000, corkBatch = 64;
+
+/**
+ * Send _messageCount_ messages with the given payload size and get the time per message in nanoseconds.
+ *
+ * The adapters are created for the ends of the socketpair by _make_.
+ */
+template<class Make>
+static double run(size_t payload, bool corked, Make&& make)
+{
+    int sv[2];
+
+    if(socketpair(AF_UNIX, SOCK_STREAM, 0, sv) != 0)
+        return -1;
+
+    double ret = -1;
+
+    {
+        auto txp = make(sv[0]), rxp = make(sv[1]);
+        auto &tx = *txp, &rx = *rxp;
+        std::vector<char> data(payload, 'x');
+        size_t received = 0;
+
+        std::thread receiver([&]()
+        {
+            while(received < messageCount && rx.receive([&](auto m)
+            {
+                auto a = m.access();
+                received += a.skip(payload);
+                return true;
+            }));
+        });
+
+        const auto t = std::chrono::steady_clock::now();
+        bool ok = true;
+
+        for(size_t i = 0; ok && i < messageCount; i += corkBatch)
+        {
+            if(corked)
+                tx.cork();
+
+            for(size_t j = 0; ok && j < corkBatch && i + j < messageCount; j++)
+            {
+                auto f = tx.messageFactory();
+                auto w = f.build(payload);
+                w.write(data.data(), payload);
+                ok = tx.send(f.done(std::move(w)));
+            }
+
+            if(corked)
+                ok = tx.uncork() && ok;
+        }
+
+        ok = tx.flush() && ok;
+        receiver.join();
+
+        if(ok && received == messageCount)
+        {
+            const std::chrono::duration<double, std::nano> d = std::chrono::steady_clock::now() - t;
+            ret = d.count() / messageCount;
+        }
+    }
+
+    close(sv[0]);
+    close(sv[1]);
+    return ret;
+}
+
+int main()
+{
+    for(size_t payload: {16u, 1024u, 3000u})
+    {
+        for(bool corked: {true, false})
+        {
+            const auto uring = run(payload, corked, [](int fd){ return std::make_unique<rpc::IoUringAdapter>(fd); });
+            const auto fd = run(payload, corked, [](int fd){ return std::make_unique<rpc::FdStreamAdapter>(fd, fd); });
+            printf("%5zu byte messages, %s: io_uring %7.0f ns, fd %7.0f ns\n", payload, corked ? "  corked" : "uncorked", uring, fd);
+        }
+    }
+
+    return 0;
+}
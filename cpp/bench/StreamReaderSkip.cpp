@@ -0,0 +1,82 @@
+/**
+ * Measures the deserialization of a StreamReader argument, that skips over the collection
+ * without parsing the elements, versus iterating through it afterwards.
+ *
+ * Build and run (from this directory):
+ *
+ *     g++ -std=c++17 -O2 -I.. StreamReaderSkip.cpp -o StreamReaderSkip && ./StreamReaderSkip
+ */
+
+#include "RpcFdStreamAdapter.h"
+#include "RpcStreamReader.h"
+
+#include <chrono>
+#include <cstdio>
+
+using Accessor = rpc::PreallocatedMemoryBufferStream::CheckedAccessor;
+using Reader = rpc::StreamReader<uint64_t, Accessor>;
+
+/**
+ * Get the best time of a few runs in nanoseconds.
+ */
+template<class C>
+static double best(int runs, C&& c)
+{
+    double ret = 1e18;
+
+    for(int i = 0; i < runs; i++)
+    {
+        const auto t = std::chrono::steady_clock::now();
+        c();
+        const std::chrono::duration<double, std::nano> d = std::chrono::steady_clock::now() - t;
+
+        if(d.count() < ret)
+            ret = d.count();
+    }
+
+    return ret;
+}
+
+int main()
+{
+    for(uint32_t n: {1000u, 1000000u, 10000000u})
+    {
+        std::vector<uint64_t> v(n);
+
+        for(uint32_t i = 0; i < n; i++)
+            v[i] = i;
+
+        std::vector<char> buffer(rpc::TypeInfo<std::vector<uint64_t>>::size(v));
+        Accessor w(buffer.data(), buffer.data() + buffer.size());
+
+        if(!rpc::TypeInfo<std::vector<uint64_t>>::write(w, v))
+            return 1;
+
+        Reader r;
+        bool ok = true;
+
+        const auto read = best(21, [&]()
+        {
+            Accessor a(buffer.data(), buffer.data() + buffer.size());
+            ok = rpc::TypeInfo<Reader>::read(a, r) && ok;
+        });
+
+        uint64_t sum = 0;
+
+        const auto iterate = best(5, [&]()
+        {
+            sum = 0;
+            auto c = r.begin();
+
+            for(uint64_t x; c.read(x);)
+                sum += x;
+        });
+
+        if(!ok || sum != uint64_t(n) * (n - 1) / 2)
+            return 1;
+
+        printf("%9u elements: read %10.1f ns, iterate %12.1f ns\n", n, read, iterate);
+    }
+
+    return 0;
+}
@@ -0,0 +1,104 @@
+/**
+ * Measures serializing and deserializing a vector of small structs that have the same layout
+ * in memory as on the wire (copied as raw bytes), versus the same struct handled member by
+ * member (it has a user provided constructor, so it is not an aggregate and is not bulk copied).
+ *
+ * Build and run (from this directory):
+ *
+ *     g++ -std=c++17 -O2 -I.. StructBulkCopy.cpp -o StructBulkCopy && ./StructBulkCopy
+ */
+
+#include "RpcFdStreamAdapter.h"
+#include "RpcStruct.h"
+
+#include <chrono>
+#include <cstdio>
+
+struct Record
+{
+    uint32_t id, flags;
+    uint64_t value;
+};
+
+struct MemberwiseRecord
+{
+    uint32_t id, flags;
+    uint64_t value;
+
+    MemberwiseRecord() = default;
+    MemberwiseRecord(uint32_t id, uint32_t flags, uint64_t value): id(id), flags(flags), value(value) {}
+};
+
+namespace rpc
+{
+    template<> struct TypeInfo<Record>: StructTypeInfo<Record,
+        StructMember<&Record::id>, StructMember<&Record::flags>, StructMember<&Record::value>> {};
+
+    template<> struct TypeInfo<MemberwiseRecord>: StructTypeInfo<MemberwiseRecord,
+        StructMember<&MemberwiseRecord::id>, StructMember<&MemberwiseRecord::flags>, StructMember<&MemberwiseRecord::value>> {};
+}
+
+static_assert(rpc::TypeInfo<Record>::isBulkCopyable() && !rpc::TypeInfo<MemberwiseRecord>::isBulkCopyable());
+
+using Accessor = rpc::PreallocatedMemoryBufferStream::CheckedAccessor;
+
+static constexpr size_t recordCount = 1000000;
+
+/**
+ * Get the best time of a few runs in milliseconds.
+ */
+template<class C>
+static double best(int runs, C&& c)
+{
+    double ret = 1e18;
+
+    for(int i = 0; i < runs; i++)
+    {
+        const auto t = std::chrono::steady_clock::now();
+        c();
+        const std::chrono::duration<double, std::milli> d = std::chrono::steady_clock::now() - t;
+
+        if(d.count() < ret)
+            ret = d.count();
+    }
+
+    return ret;
+}
+
+template<class R>
+static bool run(const char* name)
+{
+    std::vector<R> v;
+    v.reserve(recordCount);
+
+    for(uint32_t i = 0; i < recordCount; i++)
+        v.push_back(R{i, i ^ 0x5a5a5a5a, uint64_t(i) * 0x9e3779b97f4a7c15});
+
+    std::vector<char> buffer(rpc::TypeInfo<std::vector<R>>::size(v));
+    bool ok = true;
+
+    const auto write = best(7, [&]()
+    {
+        Accessor a(buffer.data(), buffer.data() + buffer.size());
+        ok = rpc::TypeInfo<std::vector<R>>::write(a, v) && ok;
+    });
+
+    std::vector<R> r;
+
+    const auto read = best(7, [&]()
+    {
+        Accessor a(buffer.data(), buffer.data() + buffer.size());
+        r = std::vector<R>();
+        ok = rpc::TypeInfo<std::vector<R>>::read(a, r) && ok;
+    });
+
+    if(!ok || r.size() != v.size() || r.back().value != v.back().value)
+        return false;
+
+    printf("%-10s write %6.2f ms, read %6.2f ms (including the allocation)\n", name, write, read);
+    return true;
+}
+
+int main() {
+    return (run<Record>("bulk") && run<MemberwiseRecord>("memberwise")) ? 0 : 1;
+}